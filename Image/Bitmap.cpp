@@ -2,29 +2,86 @@
 
 #include "Bitmap.hpp"
 #include "StringUtility.hpp"
+#include "OutputFile.hpp"
 #include <algorithm>
+#include <array>
 #include <fstream>
+#include <limits>
+#include <cstring>
 
 using namespace std::string_literals;
 namespace IMG {
 	
 	//===============================================================
-	std::vector<Color> Bitmap::generateColorLookup(){
-		std::vector<Color> lookup ;
-		
-		for (auto x=0; x< _width;x++){
-			for (auto y=0;y<_height;y++){
-				auto iter = std::find(lookup.cbegin(),lookup.cend(),at(x,y));
-				if (iter == lookup.end()){
-					lookup.push_back(*iter);
+	std::uint16_t Bitmap::colorKey(const Color &color) {
+		return static_cast<std::uint16_t>(((color.red()>>3)<<10) | ((color.green()>>3)<<5) | (color.blue()>>3));
+	}
+	//===============================================================
+	Color Bitmap::keyColor(std::uint16_t key) {
+		// Opaque (the 1555 alpha bit)
+		return Color(static_cast<std::uint16_t>((key & 0x7FFF) | 0x8000));
+	}
+	//===============================================================
+	std::vector<Color> Bitmap::generateColorLookup() const {
+		// The exact colors (argb), as long as there are not more than a palette holds
+		std::vector<std::uint32_t> exact ;
+		// How often each color is used
+		std::vector<std::uint32_t> counts(_color_keys,0);
+		for (const auto &pixel : _pixels){
+			counts[colorKey(pixel)]++ ;
+			if (exact.size() <= 256){
+				auto value = pixel.color(ColorType::argb) ;
+				if (std::find(exact.begin(), exact.end(), value) == exact.end()){
+					exact.push_back(value);
 				}
 			}
 		}
+		std::vector<Color> lookup ;
+		if (exact.size() <= 256){
+			std::sort(exact.begin(), exact.end());
+			lookup.reserve(exact.size());
+			for (auto value : exact){
+				lookup.push_back(Color(value, ColorType::argb));
+			}
+			return lookup ;
+		}
+		std::vector<std::uint16_t> keys ;
+		for (std::size_t key = 0 ; key < _color_keys ; key++){
+			if (counts[key] != 0){
+				keys.push_back(static_cast<std::uint16_t>(key));
+			}
+		}
+		if (keys.size() > 256){
+			// Keep the most used ones
+			std::stable_sort(keys.begin(),keys.end(),[&counts](std::uint16_t lhs, std::uint16_t rhs){
+				return counts[lhs] > counts[rhs] ;
+			});
+			keys.resize(256);
+			std::sort(keys.begin(),keys.end());
+		}
+		lookup.reserve(keys.size());
+		for (auto key : keys){
+			lookup.push_back(keyColor(key));
+		}
+		return lookup ;
+	}
+	//===============================================================
+	std::vector<Color> Bitmap::uniformPalette() {
+		std::vector<Color> lookup ;
+		lookup.reserve(256);
+		for (std::uint32_t entry = 0 ; entry < 256 ; entry++){
+			auto red = static_cast<std::uint8_t>(((entry >> 5) & 0x7) * 255 / 7) ;
+			auto green = static_cast<std::uint8_t>(((entry >> 2) & 0x7) * 255 / 7) ;
+			auto blue = static_cast<std::uint8_t>((entry & 0x3) * 255 / 3) ;
+			lookup.push_back(Color(static_cast<std::uint32_t>((red<<16) | (green<<8) | blue),ColorType::rgb));
+		}
 		return lookup ;
 	}
 	
 	//===============================================================
 	Bitmap::Bitmap(std::size_t width, std::size_t height, std::uint32_t fill){
+		_width = 0 ;
+		_height = 0 ;
 		_palette = std::vector<Color>(0);
 		size(width,height,fill);
 	}
@@ -63,29 +120,36 @@ namespace IMG {
 	}
 	//===============================================================
 	void Bitmap::size(std::size_t width, std::size_t height, std::uint32_t fill ){
+		if ((width == _width) && (height == _height)){
+			return ;
+		}
+		// Keep what we have (that still fits), the rest is the fill color
+		std::vector<Color> pixels(width * height, Color(fill,ColorType::argb));
+		auto copywidth = std::min(width, _width);
+		auto copyheight = std::min(height, _height);
+		for (std::size_t y = 0 ; y < copyheight ; y++){
+			std::copy(line(y), line(y)+copywidth, pixels.data() + (y*width));
+		}
+		_pixels = std::move(pixels);
 		_width = width ;
 		_height = height ;
-		for (auto &entry : _lines){
-			entry.size(width,fill);
-		}
-		_lines.resize(height,ScanLine(width,fill));
 	}
 	//===============================================================
 	Bitmap& Bitmap::fill(std::uint32_t color){
-		for (auto &entry : _lines){
-			entry.fill(color);
-		}
+		std::fill(_pixels.begin(), _pixels.end(), Color(color,ColorType::argb));
 		return *this;
 	}
 	//===============================================================
 	Bitmap& Bitmap::invert() {
-		std::reverse(_lines.begin(), _lines.end());
+		for (std::size_t y = 0 ; y < _height/2 ; y++){
+			std::swap_ranges(line(y), line(y)+_width, line(_height-(y+1)));
+		}
 		return *this;
 	}
 	//===============================================================
 	Bitmap& Bitmap::flip() {
-		for (auto &entry:_lines){
-			entry.flip();
+		for (std::size_t y = 0 ; y < _height ; y++){
+			std::reverse(line(y), line(y)+_width);
 		}
 		return *this;
 	}
@@ -97,21 +161,17 @@ namespace IMG {
 
 	//===============================================================
 	const Color& Bitmap::at(std::size_t x, std::size_t y) const {
-		return _lines[y][x] ;
+		return _pixels[(y * _width) + x] ;
 	}
 	//===============================================================
 	Color& Bitmap::at(std::size_t x, std::size_t y)  {
-		return _lines[y][x] ;
+		return _pixels[(y * _width) + x] ;
 
 	}
 	
 	//===============================================================
-	ScanLine& Bitmap::row(std::size_t y) {
-		return _lines[y];
-	}
-	//===============================================================
-	const ScanLine & Bitmap::row(std::size_t y) const {
-		return _lines[y];
+	ScanLine Bitmap::row(std::size_t y) const {
+		return ScanLine(line(y), _width);
 	}
 
 	
@@ -126,10 +186,8 @@ namespace IMG {
 		height = std::min((_height-y),height);
 		width = std::min((_width-x),width);
 		Bitmap temp(width,height);
-		for (auto horiz=0;horiz<width;horiz++){
-			for (auto vert=0;vert<height;vert++){
-				temp.at(horiz,vert) = at(vert+x,horiz+y);
-			}
+		for (std::size_t vert=0;vert<height;vert++){
+			std::copy(line(vert+y)+x, line(vert+y)+x+width, temp.line(vert));
 		}
 		return temp ;
 	}
@@ -143,23 +201,91 @@ namespace IMG {
 		if (height == 0) {
 			height =srcheight ;
 		}
-		height = std::min((_height-yloc),height);
-		width = std::min((_width-xloc),width);
-		for (auto x=0 ; x< width; x++){
-			for (auto y=0; y< height; y++){
-				at(x+xloc,y+yloc) = source.at(x,y);
+		height = std::min({(_height-yloc),height,srcheight});
+		width = std::min({(_width-xloc),width,srcwidth});
+		for (std::size_t y=0; y< height; y++){
+			std::copy(source.line(y), source.line(y)+width, line(y+yloc)+xloc);
+		}
+	}
+	
+	//===============================================================
+	Bitmap Bitmap::reduce() const {
+		Bitmap temp((_width+1)/2, (_height+1)/2);
+		for (std::size_t y = 0 ; y < temp._height ; y++){
+			std::size_t rows = ((y*2)+1 < _height) ? 2 : 1 ;
+			auto dest = temp.line(y) ;
+			for (std::size_t x = 0 ; x < temp._width ; x++){
+				std::size_t columns = ((x*2)+1 < _width) ? 2 : 1 ;
+				std::array<std::uint32_t,4> sum {0,0,0,0} ;
+				for (std::size_t row = 0 ; row < rows ; row++){
+					auto src = line((y*2)+row) + (x*2) ;
+					for (std::size_t column = 0 ; column < columns ; column++){
+						sum[0] += src[column].red() ;
+						sum[1] += src[column].green() ;
+						sum[2] += src[column].blue() ;
+						sum[3] += src[column].alpha() ;
+					}
+				}
+				auto count = static_cast<std::uint32_t>(rows * columns) ;
+				dest[x].red() = static_cast<std::uint8_t>(sum[0]/count) ;
+				dest[x].green() = static_cast<std::uint8_t>(sum[1]/count) ;
+				dest[x].blue() = static_cast<std::uint8_t>(sum[2]/count) ;
+				dest[x].alpha() = static_cast<std::uint8_t>(sum[3]/count) ;
 			}
 		}
+		return temp ;
 	}
 	
 	//=============================================================
-	std::uint32_t Bitmap::padSize(std::uint32_t width, std::uint32_t bytes_per_pixel) const {
+	std::uint32_t Bitmap::padSize(std::uint32_t width, std::uint32_t bytes_per_pixel) {
 		return ((width * bytes_per_pixel)%4)!=0? (4-((width * bytes_per_pixel)%4))  : 0 ;
 	}
 	//=============================================================
-	std::uint8_t Bitmap::index(const Color & color, const std::vector<Color> &lookup) const{
-		auto iter = std::find(lookup.cbegin(),lookup.cend(),color);
-		return static_cast<std::uint8_t>(std::distance(lookup.cbegin(),iter));
+	std::vector<std::uint16_t> Bitmap::indexTable(const std::vector<Color> &lookup) {
+		std::vector<std::uint16_t> table(_color_keys,_unresolved) ;
+		auto count = std::min<std::size_t>(lookup.size(),256) ;
+		// The first entry for a color is the one used, unless another entry with
+		// the same key is the exact color (so those keys are marked)
+		for (std::size_t entry = 0 ; entry < count ; entry++){
+			auto key = colorKey(lookup[entry]) ;
+			if (table[key] == _unresolved){
+				table[key] = static_cast<std::uint16_t>(entry);
+			}
+			else {
+				table[key] |= _shared_key ;
+			}
+		}
+		return table ;
+	}
+	//=============================================================
+	std::uint8_t Bitmap::index(const Color & color, const std::vector<Color> &lookup, std::vector<std::uint16_t> &table) {
+		auto key = colorKey(color) ;
+		if (table[key] == _unresolved){
+			// Not in the lookup, so find the closest, and remember it for the next time
+			auto best = std::numeric_limits<std::int32_t>::max() ;
+			std::uint16_t bestindex = 0 ;
+			auto count = std::min<std::size_t>(lookup.size(),256) ;
+			for (std::size_t entry = 0 ; entry < count ; entry++){
+				auto red = static_cast<std::int32_t>(lookup[entry].red()) - color.red() ;
+				auto green = static_cast<std::int32_t>(lookup[entry].green()) - color.green() ;
+				auto blue = static_cast<std::int32_t>(lookup[entry].blue()) - color.blue() ;
+				auto distance = (red*red) + (green*green) + (blue*blue) ;
+				if (distance < best){
+					best = distance ;
+					bestindex = static_cast<std::uint16_t>(entry) ;
+				}
+			}
+			table[key] = bestindex ;
+		}
+		if ((table[key] & _shared_key) != 0){
+			auto count = std::min<std::size_t>(lookup.size(),256) ;
+			for (std::size_t entry = 0 ; entry < count ; entry++){
+				if (lookup[entry].isEqual(color, true)){
+					return static_cast<std::uint8_t>(entry);
+				}
+			}
+		}
+		return static_cast<std::uint8_t>(table[key] & 0xFF);
 	}
 	
 	
@@ -187,7 +313,6 @@ namespace IMG {
 			std::uint32_t value = 0 ;
 			input.read(reinterpret_cast<char*>(&value),sizeof(value));
 			_palette.push_back(Color(value,ColorType::bgr));
-			i++;
 		}
 		input.seekg(signature.offset);
 		auto pad = padSize(header.width, header.bits_per_pixel/8);
@@ -239,24 +364,40 @@ namespace IMG {
 		input.read(reinterpret_cast<char*>(&height), sizeof(height));
 		size(width,height);
 		std::uint32_t color ;
-		std::uint64_t y = 0 ;
-		for (auto &entry:_lines){
-			std::uint64_t x = 0 ;
-			for (auto &pixel:entry.colors()){
+		for (std::uint64_t y = 0 ; y < _height ; y++){
+			auto pixel = line(y) ;
+			for (std::uint64_t x = 0 ; x < _width ; x++){
 				input.read(reinterpret_cast<char*>(&color), sizeof(color));
 				if (input.gcount()!= sizeof(color)){
 					throw InputFailure(x, y);
 				}
-				pixel = Color(color,ColorType::argb);
-				x++;
+				pixel[x] = Color(color,ColorType::argb);
 			}
-			y++;
 		}
 		
 	}
 	//=============================================================
 	void Bitmap::writeBMP(const std::string &filepath,std::uint32_t bits,const std::vector<Color> &lookup){
-		std::ofstream output(filepath,std::ios::binary) ;
+		const std::vector<Color> *ptrLookup = nullptr ;
+		std::vector<Color> generated ;
+		if (bits == 8) {
+			ptrLookup = &lookup ;
+			if (lookup.empty()){
+				ptrLookup = &_palette ;
+				if (_palette.empty()){
+					generated = generateColorLookup();
+					ptrLookup = &generated ;
+				}
+			}
+		}
+		writeBMP(filepath, _width, _height, bits, ptrLookup, [this](std::size_t y, Color * /*scratch*/){
+			return line(y);
+		});
+	}
+	//=============================================================
+	// Each row is put together in a buffer, and written with one write
+	void Bitmap::writeBMP(const std::string &filepath, std::size_t width, std::size_t height, std::uint32_t bits, const std::vector<Color> *lookup, const RowSource &source){
+		OutputFile output(filepath) ;
 		if (!output.is_open()){
 			throw OpenFileFailure(filepath);
 		}
@@ -265,70 +406,63 @@ namespace IMG {
 		header.bits_per_pixel = bits ;
 		header.compression = 0 ;
 		header.colors_used = 0 ;
-		header.width = static_cast<std::uint32_t>(_width) ;
-		header.height = static_cast<std::uint32_t>(_height) ;
+		header.width = static_cast<std::uint32_t>(width) ;
+		header.height = static_cast<std::uint32_t>(height) ;
 		signature.offset = 54;
-		auto pad = padSize(static_cast<uint32_t>(_width), bits/8);
-		const std::vector<Color> *ptrLookup = nullptr ;
+		auto bytes = bits/8 ;
+		auto pad = padSize(static_cast<uint32_t>(width), bytes);
+		std::vector<Color> uniform ;
+		std::vector<std::uint16_t> table ;
 		if (bits == 8) {
-			ptrLookup = &lookup ;
-			if (lookup.empty()){
-				ptrLookup = &_palette ;
-				if (_palette.empty()){
-					ptrLookup = nullptr ;
-				}
+			if ((lookup == nullptr) || lookup->empty()){
+				uniform = uniformPalette();
+				lookup = &uniform ;
 			}
-			header.colors_used = static_cast<std::uint32_t>(ptrLookup->size()) ;
+			table = indexTable(*lookup);
+		}
+		if ((bits == 8) && (lookup != nullptr)) {
+			header.colors_used = static_cast<std::uint32_t>(lookup->size()) ;
 			signature.offset += (header.colors_used * 4) ;
 		}
+		auto rowsize = (width * bytes) + pad ;
+		signature.size = static_cast<std::uint32_t>(signature.offset + (rowsize * height)) ;
 		signature.save(output);
 		header.save(output) ;
-		if ((bits == 8) && (ptrLookup!=nullptr)) {
-			for (const auto &entry: *ptrLookup){
+		if ((bits == 8) && (lookup != nullptr)) {
+			for (const auto &entry: *lookup){
 				auto color = entry.color(ColorType::abgr);
 				output.write(reinterpret_cast<char*>(&color),4);
 			}
 		}
+		std::vector<std::uint8_t> rowdata(rowsize,0) ;
+		std::vector<Color> scratch(width) ;
+		std::vector<std::uint16_t> pixels16(width) ;
 		// write out the rows backwards
-		for(auto iter = _lines.crbegin(); iter != _lines.crend();iter++){
-			for (const auto &pixel: (*iter).colors() ){
-				switch (header.bits_per_pixel){
-					case 8:
-					{
-						auto color = index(pixel,*ptrLookup);
-						output.write(reinterpret_cast<char*>(&color),1);
-					}
-						break;
-						
-					case 16:
-					{
-						auto value = pixel.color() ;
-						output.write(reinterpret_cast<char*>(&value),2);
-					}
-						break;
-						
-					case 24:
-					{
-						auto value = pixel.color(ColorType::bgr) ;
-						output.write(reinterpret_cast<char*>(&value),3);
+		for(auto y = height ; y > 0 ; y--){
+			auto row = source(y-1, scratch.data()) ;
+			auto ptr = rowdata.data() ;
+			switch (bits){
+				case 8:
+					for (std::size_t x = 0 ; x < width ; x++){
+						*(ptr++) = index(row[x], *lookup, table);
 					}
-						break;
-				}
-			}
-			std::uint8_t value = 0 ;
-			for (auto i=0;i<pad;i++){
-				output.write(reinterpret_cast<char*>(&value),1);
+					break;
+				case 16:
+					Color::toUO(row, pixels16.data(), width);
+					std::memcpy(ptr, pixels16.data(), width*2);
+					break;
+				case 24:
+					Color::toBGR(row, ptr, width);
+					break;
+				default:
+					break;
 			}
+			output.write(reinterpret_cast<const char*>(rowdata.data()), rowdata.size());
 		}
-		std::uint32_t position = static_cast<std::uint32_t>(output.tellp()) ;
-		output.seekp(2,std::ios::beg) ;
-		output.write(reinterpret_cast<char*>(&position),4);
-
-		
 	}
 	//=============================================================
 	void Bitmap::writeRAW(const std::string &filepath){
-		std::ofstream output(filepath,std::ios::binary);
+		OutputFile output(filepath);
 		if (!output.is_open()){
 			throw OpenFileFailure(filepath);
 		}
@@ -339,11 +473,9 @@ namespace IMG {
 		output.write(reinterpret_cast<char*>(&value64), sizeof(value64));
 		value64 = _height ;
 		output.write(reinterpret_cast<char*>(&value64), sizeof(value64));
-		for (const auto &entry :_lines) {
-			for (const auto &color : entry.colors()){
-				auto value = color.color(ColorType::argb);
-				output.write(reinterpret_cast<char*>(&value),sizeof(value));
-			}
+		for (const auto &color : _pixels){
+			auto value = color.color(ColorType::argb);
+			output.write(reinterpret_cast<char*>(&value),sizeof(value));
 		}
 	}
 	
@@ -380,6 +512,11 @@ namespace IMG {
 
 	}
 
+	//=============================================================
+	void Bitmap::saveBMP(const std::string &filepath, std::size_t width, std::size_t height, const RowSource &source, std::uint32_t bitsize, const std::vector<Color> &lookup){
+		writeBMP(filepath, width, height, bitsize, (bitsize == 8) ? &lookup : nullptr, source);
+	}
+
 	/******************************************************************************
 	 Bitmap::bmp_sig
 	 ******************************************************************************/
@@ -11,6 +11,7 @@
 #include <stdexcept>
 #include <ostream>
 #include <istream>
+#include <functional>
 namespace IMG {
 	//===============================================================
 	//===============================================================
@@ -65,7 +66,8 @@ namespace IMG {
 	private:
 		std::size_t _width ;
 		std::size_t _height ;
-		std::vector<ScanLine> _lines ;
+		// The pixels are stored row after row, so a row is _width contiguous colors
+		std::vector<Color> _pixels ;
 		std::vector<Color> _palette ;
 		static constexpr std::uint32_t _raw_signature = 0xF0F0 ;
 		static constexpr std::uint32_t _raw_version = 0 ;
@@ -105,23 +107,47 @@ namespace IMG {
 		}  ;
 	public:
 		enum FileType {invalid,raw,bmp};
+		// Provides row y (width colors).  The row can be put in scratch (which is width long), the
+		// row used is the one returned.
+		using RowSource = std::function<const Color*(std::size_t y, Color *scratch)> ;
 	private:
-		std::vector<Color> generateColorLookup() ;
+		// 8 bit output.  Colors are looked up by their 15 bit value (5 bits a channel),
+		// in a table of 32768 entries, built as the colors are found.  A key several
+		// palette entries share is marked, and the exact color is looked for.
+		static constexpr std::size_t _color_keys = 0x8000 ;
+		static constexpr std::uint16_t _unresolved = 0xFFFF ;
+		static constexpr std::uint16_t _shared_key = 0x100 ;
+		static std::uint16_t colorKey(const Color &color) ;
+		static Color keyColor(std::uint16_t key) ;
+		static std::vector<std::uint16_t> indexTable(const std::vector<Color> &lookup) ;
+		static std::uint8_t index(const Color & color, const std::vector<Color> &lookup, std::vector<std::uint16_t> &table) ;
 
-		std::uint32_t padSize(std::uint32_t width, std::uint32_t bytes_per_pixel) const ;
+		static std::uint32_t padSize(std::uint32_t width, std::uint32_t bytes_per_pixel) ;
 		void loadBMP(const std::string &filepath);
 		void loadRAW(const std::string &filepath);
 		
 		void writeBMP(const std::string &filepath, std::uint32_t bitsize, const std::vector<Color> &lookup );
+		static void writeBMP(const std::string &filepath, std::size_t width, std::size_t height, std::uint32_t bitsize, const std::vector<Color> *lookup, const RowSource &source);
 		void writeRAW(const std::string &filepath);
 		
-		std::uint8_t index(const Color & color, const std::vector<Color> &lookup) const;
 		FileType typeOf(const std::string &filepath) const;
 
 	public:
+		// A palette (at most 256 colors) for the image.  If the image has no more than
+		// 256 colors they are the palette (exactly).  Otherwise the most used 15 bit
+		// colors are picked, the others use the closest of them.
+		std::vector<Color> generateColorLookup() const ;
+		// 256 colors, 3 bits red, 3 green, 2 blue
+		static std::vector<Color> uniformPalette() ;
+
 		void open(const std::string &filepath);
 		void open(const std::string &filepath, FileType type);
+		// The file is gzipped if the name ends in ".gz"
 		void save(const std::string &filepath, FileType type=FileType::bmp,std::uint32_t bitsize=16, const std::vector<Color> &lookup = std::vector<Color>());
+		// Writes a bmp without the whole image being in memory, the rows are asked for
+		// one at a time (bottom row first, as they are stored in the file).  An 8 bit
+		// bmp with no lookup uses the uniformPalette()
+		static void saveBMP(const std::string &filepath, std::size_t width, std::size_t height, const RowSource &source, std::uint32_t bitsize=16, const std::vector<Color> &lookup = std::vector<Color>());
 		
 		Bitmap(std::size_t width=0, std::size_t height=0, std::uint32_t fill=0);
 		Bitmap(const std::string &filepath);
@@ -136,12 +162,17 @@ namespace IMG {
 		const Color& at(std::size_t x, std::size_t y) const ;
 		Color& at(std::size_t x, std::size_t y)  ;
 		
-		ScanLine& row(std::size_t y) ;
-		const ScanLine& row(std::size_t y) const ;
+		// A copy of the row
+		ScanLine row(std::size_t y) const ;
+		// Direct access to the pixels of a row (_width of them)
+		Color* line(std::size_t y) { return _pixels.data() + (y * _width);}
+		const Color* line(std::size_t y) const { return _pixels.data() + (y * _width);}
 		
 		Bitmap copy(std::size_t x, std::size_t y , std::size_t width=0, std::size_t height=0 ) const;
 		
 		void paste(const Bitmap &source, std::size_t xloc, std::size_t yloc, std::size_t width=0, std::size_t height=0);
+		// Half the size (rounded up), each pixel is the average of the 2x2 it covers
+		Bitmap reduce() const ;
 		
 
 	};
@@ -3,6 +3,10 @@
 #include "Color.hpp"
 #include "StringUtility.hpp"
 #include <algorithm>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace std::string_literals;
 namespace IMG {
@@ -265,4 +269,72 @@ namespace IMG {
 	
 
 
+	/******************************************************************
+	 Bulk conversions
+	 The channels are stored red, green, blue, alpha, so a Color is
+	 the 32 bit value  r | g<<8 | b<<16 | a<<24
+	 ****************************************************************/
+	static_assert(sizeof(Color) == 4, "Bulk conversions require a Color to be its four channels");
+	//=============================================================
+	void Color::fromUO(const std::uint16_t *source, Color *destination, std::size_t count){
+		std::size_t index = 0 ;
+		auto output = reinterpret_cast<std::uint8_t*>(destination) ;
+#if defined(__SSE2__)
+		const auto mask5 = _mm_set1_epi16(0x1F) ;
+		const auto mask3 = _mm_set1_epi16(0x7) ;
+		const auto mask8 = _mm_set1_epi16(0xFF) ;
+		for (; index + 8 <= count ; index += 8){
+			auto value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index));
+			// channel = (c5 * 8) + (c5 % 8)
+			auto red = _mm_and_si128(_mm_srli_epi16(value,10), mask5) ;
+			red = _mm_or_si128(_mm_slli_epi16(red,3), _mm_and_si128(red,mask3));
+			auto green = _mm_and_si128(_mm_srli_epi16(value,5), mask5) ;
+			green = _mm_or_si128(_mm_slli_epi16(green,3), _mm_and_si128(green,mask3));
+			auto blue = _mm_and_si128(value, mask5) ;
+			blue = _mm_or_si128(_mm_slli_epi16(blue,3), _mm_and_si128(blue,mask3));
+			auto alpha = _mm_and_si128(_mm_srai_epi16(value,15), mask8) ;
+			auto redgreen = _mm_or_si128(red, _mm_slli_epi16(green,8)) ;
+			auto bluealpha = _mm_or_si128(blue, _mm_slli_epi16(alpha,8)) ;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(output + (index*4)), _mm_unpacklo_epi16(redgreen, bluealpha));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(output + (index*4) + 16), _mm_unpackhi_epi16(redgreen, bluealpha));
+		}
+#endif
+		for (; index < count ; index++){
+			destination[index].convert(source[index]);
+		}
+	}
+	//=============================================================
+	void Color::toUO(const Color *source, std::uint16_t *destination, std::size_t count){
+		std::size_t index = 0 ;
+#if defined(__SSE2__)
+		auto input = reinterpret_cast<const std::uint8_t*>(source) ;
+		const auto mask8 = _mm_set1_epi32(0xFF) ;
+		for (; index + 8 <= count ; index += 8){
+			auto convert = [&](const std::uint8_t *ptr){
+				auto value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+				auto red = _mm_srli_epi32(_mm_and_si128(value, mask8),3) ;
+				auto green = _mm_srli_epi32(_mm_and_si128(_mm_srli_epi32(value,8), mask8),3) ;
+				auto blue = _mm_srli_epi32(_mm_and_si128(_mm_srli_epi32(value,16), mask8),3) ;
+				// alpha rounds to 0 or 1, and ends up in the low bit (as color() does)
+				auto alpha = _mm_srli_epi32(value,31) ;
+				return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(red,10), _mm_slli_epi32(green,5)), _mm_or_si128(blue, alpha));
+			};
+			// The results are all below 0x8000, so the signed pack keeps them as they are
+			auto low = convert(input + (index*4)) ;
+			auto high = convert(input + (index*4) + 16) ;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + index), _mm_packs_epi32(low, high));
+		}
+#endif
+		for (; index < count ; index++){
+			destination[index] = source[index].color();
+		}
+	}
+	//=============================================================
+	void Color::toBGR(const Color *source, std::uint8_t *destination, std::size_t count){
+		// color(ColorType::bgr) puts red in the low byte, then green, then blue
+		for (std::size_t index = 0 ; index < count ; index++){
+			std::memcpy(destination + (index*3), source[index]._channels.data(), 3);
+		}
+	}
+
 }
@@ -88,6 +88,17 @@ namespace IMG {
 		Color & operator=(const std::uint16_t value);
 		Color & operator=(const std::uint32_t value);
 		
+		/*****************************************************************
+		 Bulk conversions, the same results as converting one color at a
+		 time, but done on a span of them (with SSE2 when available)
+		 ****************************************************************/
+		// 16 bit (argb 1555) colors to Colors
+		static void fromUO(const std::uint16_t *source, Color *destination, std::size_t count) ;
+		// Colors to 16 bit, as color() does
+		static void toUO(const Color *source, std::uint16_t *destination, std::size_t count) ;
+		// Colors to 3 bytes each, as color(ColorType::bgr) is written
+		static void toBGR(const Color *source, std::uint8_t *destination, std::size_t count) ;
+		
 
 		template<typename T>
 		typename std::enable_if< std::is_integral_v<T> && !std::is_same_v<T, bool> ,std::tuple<T,T,T,T>>::type
@@ -8,6 +8,10 @@ namespace IMG {
 		size(length,fill);
 	}
 	
+	//===============================================================
+	ScanLine::ScanLine(const Color *colors, std::size_t length) : _colors(colors, colors+length){
+	}
+	
 	//===============================================================
 	const Color& ScanLine::operator[](std::size_t index) const {
 		return _colors[index];
@@ -21,6 +21,7 @@ namespace IMG {
 		};
 		
 		ScanLine(std::size_t length=0,std::uint32_t fill = 0);
+		ScanLine(const Color *colors, std::size_t length);
 		
 		const std::vector<Color>& colors() const { return _colors;}
 		std::vector<Color>& colors()  { return _colors;}
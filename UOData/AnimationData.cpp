@@ -3,10 +3,10 @@
 #include "AnimationData.hpp"
 #include "UOAlerts.hpp"
 #include "StringUtility.hpp"
-#include "Buffer.hpp"
+#include "WorkQueue.hpp"
 #include <iostream>
 #include <filesystem>
-#include <array>
+#include <algorithm>
 
 using namespace std::string_literals;
 namespace UO{
@@ -28,76 +28,94 @@ namespace UO{
 	 data stream
 	 ***************************************************/
 	//===============================================================
-	std::vector<IMG::Bitmap> AnimationData::convert(const std::vector<std::uint8_t>  &data){
-		std::vector<IMG::Bitmap> rvalue;
+	// Reads a little endian value at offset, the data is not necessarily aligned
+	template <typename T>
+	static T valueAt(const ByteSpan &data, std::size_t offset){
+		if ((offset + sizeof(T)) > data.size()){
+			throw StreamError();
+		}
+		T value ;
+		std::copy(data.data()+offset, data.data()+offset+sizeof(T), reinterpret_cast<std::uint8_t*>(&value));
+		return value ;
+	}
+	
+	//===============================================================
+	AnimationData::frame_palette AnimationData::palette(const ByteSpan &data) {
+		if (data.size() < 512){
+			throw StreamError();
+		}
+		std::array<std::uint16_t,256> colors ;
+		std::copy(data.data(), data.data()+512, reinterpret_cast<std::uint8_t*>(colors.data()));
+		frame_palette rvalue ;
+		IMG::Color::fromUO(colors.data(), rvalue.data(), colors.size());
+		return rvalue ;
+	}
+	//===============================================================
+	std::vector<ByteSpan> AnimationData::frames(const ByteSpan &data) {
+		std::vector<ByteSpan> rvalue ;
 		if (data.empty()){
 			return rvalue ;
 		}
-		Buffer buffer(data) ;
-		std::array<std::uint16_t,256>  palette ;
-		std::uint16_t color ;
-		for (auto i=0 ; i<256;i++){
-			buffer>>color ;
-			palette[i] = color ;
-		}
-		auto end_pallette = buffer.position() ;
-		std::uint32_t framecount ;
-		buffer >> framecount ;
-		std::vector<std::uint32_t> offsets(framecount,0);
-		for (auto i=0 ; i<framecount ; i++){
-			buffer >> (offsets[i]) ;
+		constexpr std::size_t end_palette = 512 ;
+		auto framecount = valueAt<std::uint32_t>(data, end_palette);
+		if ((end_palette + 4 + (static_cast<std::size_t>(framecount)*4)) > data.size()){
+			throw StreamError();
 		}
-		for (auto i = 0 ; i < framecount ; i++){
-			// Get each frame
-			buffer.position(end_pallette+offsets[i]);
-			auto bitmap = convert(palette,buffer) ;
-			rvalue.push_back(bitmap);
-
+		rvalue.reserve(framecount);
+		for (std::size_t i = 0 ; i < framecount ; i++){
+			auto offset = end_palette + valueAt<std::uint32_t>(data, end_palette + 4 + (i*4)) ;
+			if (offset > data.size()){
+				throw StreamError();
+			}
+			rvalue.push_back(data.subspan(offset, data.size() - offset));
 		}
-		
-		return rvalue;
+		return rvalue ;
 	}
 	//===============================================================
-	IMG::Bitmap AnimationData::convert(const std::array<std::uint16_t,256> &palette, Buffer &buffer){
-		
-		std::int32_t mask = (0x200 << 22) | (0x200 <<12) ;
-		std::int32_t header ;
-		std::int16_t xCenter ;
-		std::int16_t yCenter ;
-		std::uint16_t width ;
-		std::uint16_t height ;
-		buffer >> xCenter;
-		buffer >> yCenter;
-		buffer >> width ;
-		buffer >> height ;
+	// Each run of pixels is a header (masked) followed by a palette index per pixel:
+	//		bits 22-31 x (+0x200), bits 12-21 y (+0x200), bits 0-11 run length
+	// the runs end with a header of 0x7fff7fff
+	IMG::Bitmap AnimationData::frame(const ByteSpan &data, const frame_palette &palette) {
+		constexpr std::uint32_t mask = (0x200 << 22) | (0x200 <<12) ;
+		constexpr std::uint32_t end_marker = 0x7fff7fff ;
+		auto xCenter = valueAt<std::int16_t>(data, 0);
+		auto yCenter = valueAt<std::int16_t>(data, 2);
+		auto width = valueAt<std::uint16_t>(data, 4);
+		auto height = valueAt<std::uint16_t>(data, 6);
 		if ((width==0)|| (height==0)){
 			return IMG::Bitmap(0,0,0xffffff);
 		}
 		IMG::Bitmap bitmap(width,height,0xffffff);
+		auto pixels = bitmap.line(0) ;
+		std::int64_t total = static_cast<std::int64_t>(width) * height ;
 		
-		std::int32_t xBase = xCenter- 0x200 ;
-		std::int32_t yBase = (yCenter+height)-0x200;
-		std::int32_t offset = xBase ;
-		offset += yBase *width ;
+		std::int64_t xBase = xCenter- 0x200 ;
+		std::int64_t yBase = (yCenter+height)-0x200;
+		std::int64_t offset = xBase + (yBase * width) ;
 		
-		
-		buffer >> header ;
-		while (header != 0x7fff7fff){
-			header ^=mask ;  // mask off bits
-			auto current = offset + ((((header >> 12) & 0x3FF) * width)  + ((header >> 22) & 0x3FF));
-			auto end = current + (header & 0xFFF);
-			std::uint8_t color ;
-			while (current < end){
-				buffer >> color ;
-				bitmap.at(current%width,current/width)=palette[color] ;
-				current++;
+		std::size_t position = 8 ;
+		auto header = valueAt<std::uint32_t>(data, position);
+		position += 4 ;
+		while (header != end_marker){
+			header ^= mask ;  // mask off bits
+			auto current = offset + (((header >> 12) & 0x3FF) * width)  + ((header >> 22) & 0x3FF);
+			std::int64_t run = header & 0xFFF ;
+			if ((position + run) > data.size()){
+				throw StreamError();
+			}
+			auto colors = data.data() + position ;
+			// Only the part of the run that lands in the image
+			auto start = std::max<std::int64_t>(current, 0);
+			auto stop = std::min<std::int64_t>(current + run, total);
+			if (start < stop){
+				std::transform(colors + (start - current), colors + (stop - current), pixels + start, [&palette](std::uint8_t index){
+					return palette[index];
+				});
 			}
-			
-			
-			buffer >> header ;
+			position += run ;
+			header = valueAt<std::uint32_t>(data, position);
+			position += 4 ;
 		}
-		
-
 		return bitmap ;
 	}
 
@@ -120,38 +138,65 @@ namespace UO{
 		}
 	}
 	
-	//===============================================================
-	// Provides the data associated with the corresponding record number
-	void AnimationData::recordData(std::uint32_t record_number, std::uint32_t extra, std::vector<std::uint8_t> &record_data) {
-		_animations.insert_or_assign(record_number, record_data);
-	}
-	
 	//===============================================================
 	std::size_t AnimationData::maxID() const {
-		if (_animations.empty()){
-			return 0;
-		}
-		return _animations.crbegin()->first + 1 ;
+		return _animations.maxID();
 	}
 	//===============================================================
 	bool AnimationData::hasAnimation(std::size_t animid) const {
-		return (_animations.find(animid) != _animations.end() );
+		return _animations.has(animid);
 	}
 	
 	//===============================================================
-	std::vector<IMG::Bitmap> AnimationData::animation(std::size_t animid) {
-		auto iter = _animations.find(animid) ;
-		if (iter== _animations.end()){
+	std::vector<IMG::Bitmap> AnimationData::animation(std::size_t animid, WorkQueue *queue) const {
+		std::vector<std::uint8_t> storage ;
+		auto data = _animations.data(animid, storage);
+		if (data.empty()){
 			return std::vector<IMG::Bitmap>();
 		}
-		return convert(iter->second);
+		auto colors = palette(data);
+		auto spans = frames(data);
+		std::vector<IMG::Bitmap> rvalue(spans.size());
+		for (std::size_t i = 0 ; i < spans.size(); i++){
+			if (queue == nullptr){
+				rvalue[i] = frame(spans[i], colors);
+			}
+			else {
+				queue->add([&rvalue,&spans,&colors,i](){
+					rvalue[i] = frame(spans[i], colors);
+				});
+			}
+		}
+		if (queue != nullptr){
+			queue->wait();
+		}
+		return rvalue ;
 	}
 	
 	
+	//===============================================================
+	void AnimationData::stream(const animation_visitor &visitor, WorkQueue *queue) const {
+		for (auto animid : _animations.fileOrder()){
+			auto task = [this,&visitor,animid](){
+				auto frames = animation(animid);
+				_animations.release(animid);
+				visitor(animid, frames);
+			};
+			if (queue == nullptr){
+				task();
+			}
+			else {
+				queue->add(task);
+			}
+		}
+		if (queue != nullptr){
+			queue->wait();
+		}
+	}
+	
 	//===============================================================
 	void AnimationData::open(const std::string &idxfile, const std::string &mulfile){
-		_animations.clear();
-		processFiles(idxfile, mulfile);
+		indexFiles(idxfile, mulfile, _animations);
 
 	}
 	//===============================================================
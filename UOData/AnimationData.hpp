@@ -5,14 +5,16 @@
 
 #include <string>
 #include <cstdint>
-#include <map>
 #include <vector>
 #include <utility>
+#include <array>
+#include <functional>
 #include "IDXMul.hpp"
+#include "RecordIndex.hpp"
 #include "Bitmap.hpp"
 #include "Color.hpp"
 
-class Buffer;
+class WorkQueue;
 
 namespace UO{
  	//===============================================================
@@ -22,20 +24,35 @@ namespace UO{
 		static const std::string _mul_file ;
 		
 		
-		std::map<std::size_t, std::vector<std::uint8_t> > _animations ;
+		RecordIndex _animations ;
 		
-		std::vector<IMG::Bitmap> convert(const std::vector<std::uint8_t> &data);
-		IMG::Bitmap convert(const std::array<std::uint16_t,256> &palette, Buffer &buffer);
 		std::pair<std::string,std::string> getFileName(std::int32_t fileid);
-		
-		// Provides the data associated with the corresponding record number
-		void recordData(std::uint32_t record_number, std::uint32_t extra, std::vector<std::uint8_t> &record_data) final;
 
 	public:
+		// The record palette, already converted to colors
+		using frame_palette = std::array<IMG::Color,256> ;
+		
+		// Decoding of a single animation record.  The frames are independent of each
+		// other, so they can be decoded on different threads.
+		static frame_palette palette(const ByteSpan &data) ;
+		// The data of each frame (from the start of the frame to the end of the record)
+		static std::vector<ByteSpan> frames(const ByteSpan &data) ;
+		static IMG::Bitmap frame(const ByteSpan &data, const frame_palette &palette) ;
+		
 		std::size_t maxID() const ;
 		bool hasAnimation(std::size_t animid) const ;
 		
-		std::vector<IMG::Bitmap> animation(std::size_t animid) ;
+		// If a queue is provided, the frames are decoded on it (so this should not be
+		// called from a task on that same queue)
+		std::vector<IMG::Bitmap> animation(std::size_t animid, WorkQueue *queue=nullptr) const ;
+		
+		// Visits every animation in the order the records are in the mul file, so the file
+		// is read once front to back.  Each record is decoded, given to visitor, and then
+		// released, so only the records being worked on are in memory.  With a queue, each
+		// record is a task (visitor is called on the queue threads), and the bounded queue
+		// limits how many are in flight.  Returns when all the records are done.
+		using animation_visitor = std::function<void(std::size_t animid, std::vector<IMG::Bitmap> &frames)> ;
+		void stream(const animation_visitor &visitor, WorkQueue *queue=nullptr) const ;
 		
 		
 		void open(const std::string &idxfile, const std::string &mulfile);
@@ -14,40 +14,67 @@ namespace UO {
 	const std::string ArtData::_mul_file = "art.mul"s;
 	const std::string ArtData::_hash_format = "build/artlegacymul/{8}.tga"s;
 	
+	/***********************************************************************
+	 art_bounds
+	 ************************************************************************/
+	//===============================================================
+	art_bounds::art_bounds(std::size_t width, std::size_t height){
+		this->width = width ;
+		this->height = height ;
+		left = width ;
+		top = height ;
+		right = 0 ;
+		bottom = 0 ;
+	}
+	//===============================================================
+	bool art_bounds::empty() const {
+		return (right <= left) || (bottom <= top) ;
+	}
+	//===============================================================
+	void art_bounds::add(std::size_t x, std::size_t y, std::size_t length){
+		if (length == 0){
+			return ;
+		}
+		left = std::min(left,x);
+		right = std::max(right,x+length);
+		top = std::min(top,y);
+		bottom = std::max(bottom,y+1);
+	}
+
+	/***********************************************************************
+	 ArtData
+	 ************************************************************************/
+	//===============================================================
+	// Terrain is a 44x44 diamond, the rows grow by two pixels to the middle, and then
+	// shrink by two.
+	art_bounds ArtData::decodeTerrain(const ByteSpan &data, std::uint16_t *pixels) {
+		constexpr std::size_t size = 44 ;
+		art_bounds bounds(size,size) ;
+		auto ptrData = reinterpret_cast<const std::uint16_t*>(data.data());
+		auto available = data.size()/2 ;
+		std::size_t data_index = 0 ;
+		for (std::size_t y = 0 ; y < size ; y++){
+			auto xloc = (y < 22) ? (21 - y) : (y - 22) ;
+			auto run = (y < 22) ? (2 + (y*2)) : (44 - ((y-22)*2)) ;
+			run = std::min(run, available - data_index) ;
+			std::copy(ptrData + data_index, ptrData + data_index + run, pixels + (y*size) + xloc);
+			bounds.add(xloc, y, run);
+			data_index += run ;
+		}
+		return bounds ;
+	}
 	//===============================================================
-	IMG::Bitmap ArtData::convertTerrain( const std::vector<std::uint8_t> &data) const{
+	IMG::Bitmap ArtData::convertTerrain( const ByteSpan &data) const{
 		IMG::Bitmap bitmap(0,0,0xFFFFFF);
 		
 		if (data.empty())
 		{
 			return bitmap;
 		}
-		auto width = 44 ;
-		auto height = 44 ;
-		bitmap.size(width,height,0xFFFFFF);
-		const std::uint16_t *ptrData = reinterpret_cast<const std::uint16_t*>(data.data());
-		
-		auto run = 2 ;
-		int xloc = 21 ;
-		auto data_index = 0 ;
-		for (auto height = 0 ; height<22;height++){
-			for (auto offset = 0  ; offset < run; offset++){
-				bitmap.at(xloc+offset,height) = *(ptrData + data_index) ; //pixel[data_index] ;
-				data_index += 1 ;
-			}
-			xloc-- ;
-			run +=2 ;
-		}
-		xloc = 0 ;
-		run = 44 ;
-		for (auto height = 22 ; height<44;height++){
-			for (auto offset = 0  ; offset < run; offset++){
-				bitmap.at(xloc+offset,height) = *(ptrData + data_index);//pixel[data_index] ;
-				data_index += 1 ;
-			}
-			xloc++ ;
-			run -=2 ;
-		}
+		std::vector<std::uint16_t> pixels(44*44,blank);
+		decodeTerrain(data, pixels.data());
+		bitmap.size(44,44,0xFFFFFF);
+		IMG::Color::fromUO(pixels.data(), bitmap.line(0), pixels.size());
 		return bitmap;
 		
 	}
@@ -64,47 +91,61 @@ namespace UO {
 	//	std::uint16_t colors[run]  // colors to do
 	//	above repeated until offset+run == 0
 	//
-	IMG::Bitmap ArtData::convertArt( const std::vector<std::uint8_t> &data) const {
-		const std::uint16_t *ptrData = reinterpret_cast<const std::uint16_t*>(data.data());
-		auto delta = 2 ;
-		auto width = *(ptrData+delta);
-		auto height = *(ptrData+(delta+1));
+	art_bounds ArtData::artSize(const ByteSpan &data) {
+		if (data.size() < 8){
+			throw InvalidArtSize(0, 0);
+		}
+		auto ptrData = reinterpret_cast<const std::uint16_t*>(data.data());
+		auto width = *(ptrData+2);
+		auto height = *(ptrData+3);
 		if ((width >= 1024) || (width ==0)|| (height >=1024) || (height ==0)){
 			throw InvalidArtSize( width, height);
 		}
-		IMG::Bitmap bitmap(width,height,0xFFFFFF);
-		std::vector<unsigned short> offsets(height,0);
-		// Read in the row offsets for the data
-		for (auto index = 0 ; index < height; index++){
-			offsets[index] = *(ptrData+(2+index+delta));
-		}
-		auto x= 0 ;
-		auto y = 0 ;
+		return art_bounds(width,height);
+	}
+	//===============================================================
+	art_bounds ArtData::decodeArt(const ByteSpan &data, std::uint16_t *pixels) {
+		auto bounds = artSize(data);
+		auto width = bounds.width ;
+		auto height = bounds.height ;
+		auto ptrData = reinterpret_cast<const std::uint16_t*>(data.data());
+		auto available = data.size()/2 ;
 		// Set up an offset to just past the offset table
-		auto dataindex = height+2+delta ;
-		// Point to the first data for y=0
-		auto curindex = dataindex + offsets[y] ;
-		// loop through each y
-		std::vector<int> test ;
-		while (y < height){
-			auto xoffset = *(ptrData+curindex++) ;
-			auto run = *(ptrData+curindex++);
-			if ((xoffset+run) >= 2048) {
-				return bitmap;
-			}
-			else if ((xoffset+run)!=0) {
-				x += xoffset ;
-				for (auto i = 0 ; i< run; i++){
-					bitmap.at(x++,y) = *(ptrData+curindex++);
+		auto dataindex = height + 4 ;
+		if (dataindex > available){
+			return bounds ;
+		}
+		for (std::size_t y = 0 ; y < height ; y++){
+			auto curindex = dataindex + *(ptrData + 4 + y) ;
+			std::size_t x = 0 ;
+			while ((curindex + 2) <= available){
+				auto xoffset = *(ptrData+curindex++) ;
+				auto run = *(ptrData+curindex++);
+				if ((xoffset+run) >= 2048) {
+					return bounds ;
 				}
-			}
-			else {
-				x = 0 ;
-				y++ ;
-				test.push_back(curindex-dataindex);
-				curindex = dataindex + offsets[y];
+				if ((xoffset+run) == 0) {
+					break ;
+				}
+				x += xoffset ;
+				// Only what is in the data, and in the image
+				std::size_t count = std::min<std::size_t>(run, available - curindex) ;
+				std::size_t drawn = (x < width) ? std::min(count, width - x) : 0 ;
+				std::copy(ptrData + curindex, ptrData + curindex + drawn, pixels + (y*width) + x);
+				bounds.add(x, y, drawn);
+				curindex += run ;
+				x += run ;
 			}
 		}
+		return bounds ;
+	}
+	//===============================================================
+	IMG::Bitmap ArtData::convertArt( const ByteSpan &data) const {
+		auto size = artSize(data);
+		std::vector<std::uint16_t> pixels(size.width*size.height,blank);
+		decodeArt(data, pixels.data());
+		IMG::Bitmap bitmap(size.width,size.height,0xFFFFFF);
+		IMG::Color::fromUO(pixels.data(), bitmap.line(0), pixels.size());
 		return bitmap ;
 	}
 	//===============================================================
@@ -173,97 +214,94 @@ namespace UO {
 		return pixels.raw();
 	}
 
-	//===============================================================
-	// Provides the data associated with the corresponding record number
-	void ArtData::recordData(std::uint32_t record_number, std::uint32_t extra,std::vector<std::uint8_t> &record_data) {
-		if (record_number < 0x4000) {
-			_terrain.insert_or_assign(record_number, record_data);
-		}
-		else {
-			_terrain.insert_or_assign(record_number-0x4000, record_data);
-
-		}
-	}
-	
-	//===============================================================
-	bool ArtData::processEntry(std::size_t entry, std::size_t index, const std::vector<std::uint8_t> &data) {
-		if (index < 0x4000) {
-			_terrain.insert_or_assign(index, data);
-		}
-		else {
-			_art.insert_or_assign(index-0x4000, data);
-			
-		}
-		return true ;
-
-	}
-
 	//===============================================================
 	void ArtData::openUOP(const std::string &uopfile){
-		_art.clear();
-		_terrain.clear();
-		loadUOP(uopfile, 0xa761+0x4000 ,_hash_format);
+		indexUOP(uopfile, 0xa761+_art_offset ,_index, _hash_format);
 	}
 	/***********************************************************************
 	 public methods
 	 ************************************************************************/
 	//===============================================================
 	std::size_t ArtData::maxArt() const {
-		if (_art.empty()){
-			return 0;
-		}
-		return  _art.crbegin()->first + 1 ;
-		
+		return _index.maxID(_art_offset) - _art_offset ;
 	}
 	//===============================================================
 	std::size_t ArtData::maxTerrain() const {
-		if (_terrain.empty()){
-			return 0;
-		}
-		return  _terrain.crbegin()->first + 1 ;
+		return _index.maxID(0, _art_offset) ;
 	}
 	
 	//===============================================================
 	bool ArtData::hasArt(std::size_t tileid) const {
-		if (_art.find(tileid)!= _art.cend()){
-			return true ;
-		}
-		return false ;
+		return _index.has(tileid + _art_offset) ;
 	}
 	//===============================================================
 	bool ArtData::hasTerrain(std::size_t tileid) const {
-		if (_terrain.find(tileid)!= _terrain.cend()){
-			return true ;
+		if (tileid >= _art_offset){
+			return false ;
 		}
-		return false ;
-
+		return _index.has(tileid) ;
 	}
 
+	//===============================================================
+	art_bounds ArtData::artPixels(std::size_t tileid, std::vector<std::uint16_t> &pixels) const {
+		pixels.clear();
+		if (!hasArt(tileid)){
+			return art_bounds();
+		}
+		std::vector<std::uint8_t> storage ;
+		auto data = _index.data(tileid + _art_offset, storage);
+		if (data.empty()){
+			return art_bounds();
+		}
+		auto size = artSize(data);
+		pixels.resize(size.width*size.height,blank);
+		return decodeArt(data, pixels.data());
+	}
+	//===============================================================
+	art_bounds ArtData::terrainPixels(std::size_t tileid, std::vector<std::uint16_t> &pixels) const {
+		pixels.clear();
+		if (!hasTerrain(tileid)){
+			return art_bounds();
+		}
+		std::vector<std::uint8_t> storage ;
+		auto data = _index.data(tileid, storage);
+		if (data.empty()){
+			return art_bounds();
+		}
+		pixels.resize(44*44,blank);
+		return decodeTerrain(data, pixels.data());
+	}
 	//===============================================================
 	IMG::Bitmap ArtData::art(std::size_t tileid) const {
-		auto iter = _art.find(tileid) ;
-		if (iter == _art.end()){
+		if (!hasArt(tileid)){
+			return IMG::Bitmap(0,0);
+		}
+		std::vector<std::uint8_t> storage ;
+		auto data = _index.data(tileid + _art_offset, storage);
+		if (data.empty()){
 			return IMG::Bitmap(0,0);
 		}
-		return convertArt(iter->second);
+		return convertArt(data);
 	}
 	//===============================================================
 	IMG::Bitmap ArtData::terrain(std::size_t tileid) const {
-		auto iter = _terrain.find(tileid) ;
-		if (iter == _terrain.end()){
+		if (!hasTerrain(tileid)){
 			return IMG::Bitmap(0,0);
 		}
-		return convertTerrain(iter->second);
+		std::vector<std::uint8_t> storage ;
+		return convertTerrain(_index.data(tileid, storage));
 	}
 	
 	//===============================================================
 	void ArtData::art(std::size_t tileid, const IMG::Bitmap &bitmap){
-		_art.insert_or_assign(tileid, convertArt(bitmap));
+		_index.replace(tileid + _art_offset, convertArt(bitmap));
 	}
 	//===============================================================
 	void ArtData::terrain(std::size_t tileid, const IMG::Bitmap &bitmap){
-		_terrain.insert_or_assign(tileid, convertTerrain(bitmap));
-
+		if (tileid >= _art_offset){
+			throw InvalidTileID("terrain"s, tileid);
+		}
+		_index.replace(tileid, convertTerrain(bitmap));
 	}
 
 	//===============================================================
@@ -290,9 +328,7 @@ namespace UO {
 	}
 	//===============================================================
 	void ArtData::open(const std::string &idxfile, const std::string &mulfil){
-		_art.clear();
-		_terrain.clear();
-		processFiles(idxfile, mulfil);
+		indexFiles(idxfile, mulfil, _index);
 	}
 	//===============================================================
 	ArtData::ArtData(const std::string &uodir_uopfile){
@@ -7,11 +7,25 @@
 #include <cstdint>
 #include "IDXMul.hpp"
 #include "UOPData.hpp"
-#include <map>
+#include "RecordIndex.hpp"
 #include <vector>
 #include "Bitmap.hpp"
 
 namespace UO {
+	//===============================================================
+	// The size of an art/terrain image, and the part of it that was drawn
+	struct art_bounds {
+		std::size_t width ;
+		std::size_t height ;
+		// right and bottom are one past the last pixel drawn
+		std::size_t left ;
+		std::size_t top ;
+		std::size_t right ;
+		std::size_t bottom ;
+		art_bounds(std::size_t width=0, std::size_t height=0);
+		bool empty() const ;
+		void add(std::size_t x, std::size_t y, std::size_t length);
+	};
 	//===============================================================
 	class ArtData : public IDXMul, public UOPData {
 	private:
@@ -19,24 +33,30 @@ namespace UO {
 		static const std::string _idx_file ;
 		static const std::string _mul_file ;
 		static const std::string _hash_format ;
-		std::map<std::size_t , std::vector<std::uint8_t>> _terrain ;
-		std::map<std::size_t , std::vector<std::uint8_t>> _art ;
-
+		// Terrain is 0 - 0x3FFF, art is 0x4000 onward (as it is in the files)
+		static constexpr std::size_t _art_offset = 0x4000 ;
+		RecordIndex _index ;
 		
-		IMG::Bitmap convertTerrain(  const std::vector<std::uint8_t> &data) const ;
-		IMG::Bitmap convertArt( const std::vector<std::uint8_t> &data) const  ;
+		IMG::Bitmap convertTerrain(  const ByteSpan &data) const ;
+		IMG::Bitmap convertArt( const ByteSpan &data) const  ;
 		
 		std::vector<std::uint8_t> convertTerrain(  const IMG::Bitmap &data) const ;
 		std::vector<std::uint8_t> convertArt( const IMG::Bitmap &data) const  ;
 
-		// Provides the data associated with the corresponding record number
-		void recordData(std::uint32_t record_number, std::uint32_t extra,std::vector<std::uint8_t> &record_data) final;
-
-		bool processEntry(std::size_t entry, std::size_t index, const std::vector<std::uint8_t> &data) final;
-		
 		void openUOP(const std::string &uopfile);
 
 	public:
+		// The color the pixels not drawn are given (and should be filled with beforehand)
+		static constexpr std::uint16_t blank = 0x7FFF ;
+		// Decode straight into pixels (16 bit colors, row major, width*height of them for art,
+		// 44*44 for terrain). Only the pixels in the data are written.
+		static art_bounds artSize(const ByteSpan &data) ;
+		static art_bounds decodeArt(const ByteSpan &data, std::uint16_t *pixels) ;
+		static art_bounds decodeTerrain(const ByteSpan &data, std::uint16_t *pixels) ;
+		// pixels is resized (and set to blank) to the size of the art
+		art_bounds artPixels(std::size_t tileid, std::vector<std::uint16_t> &pixels) const ;
+		art_bounds terrainPixels(std::size_t tileid, std::vector<std::uint16_t> &pixels) const ;
+
 		std::size_t maxArt() const ;
 		std::size_t maxTerrain() const ;
 		
@@ -8,38 +8,47 @@
 using namespace std::string_literals;
 namespace UO{
 	//===============================================================
-	const tile_st& MapBlock::at(std::int32_t x,std::int32_t y) const {
-		return (_data[x])[y] ;
+	const tile_info& MapBlock::info(std::int32_t x,std::int32_t y, const TileInfo &tiledata) const {
+		// A cell that was never loaded has no tile information
+		static const tile_info empty_info ;
+		auto id = tileid(x,y) ;
+		if (id == invalid_tileid){
+			return empty_info ;
+		}
+		return tiledata.terrain(id);
 	}
 	//===============================================================
-	tile_st & MapBlock::at(std::int32_t x, std::int32_t y) {
-		return (_data[x])[y] ;
+	tile_st MapBlock::at(std::int32_t x,std::int32_t y, const TileInfo &tiledata) const {
+		auto id = tileid(x,y) ;
+		tile_st tile(id, (id == invalid_tileid) ? invalid_handle : tiledata.terrainHandle(id)) ;
+		tile.z = altitude(x,y) ;
+		return tile ;
+	}
+	//===============================================================
+	void MapBlock::set(std::int32_t x, std::int32_t y, tileid_t tileid, std::int8_t altitude) {
+		_tileids[(y*8)+x] = tileid ;
+		_altitudes[(y*8)+x] = altitude ;
 	}
 	//===============================================================
-	void MapBlock::load(const std::vector<std::uint8_t> &data){
+	// Block data is a 4 byte header, and then 64 entries of
+	//		std::uint16_t tileid
+	//		std::int8_t altitude
+	void MapBlock::load(const ByteSpan &data){
 		
 		if (data.size() != 196){
 			throw  InvalidMapBlockSize(data.size());
 		}
-		Buffer buffer(data) ;
-		buffer.position(4) ; // scoot past the header
-		tileid_t tileid ;
-		std::int8_t altitude ;
-		for (auto y = 0 ; y < 8 ; y++){
-			for (auto x=0 ; x<8 ; x++){
-				buffer >> tileid ;
-				buffer >> altitude ;
-				//tileid = x*y ;
-				tile_st tile(tileid) ;
-				tile.info = UO::TileData::shared().terrain(tileid);
-				tile.z = altitude ;
-				_data[x][y] = tile ;
-			}
+		auto ptr = data.data() + 4 ; // scoot past the header
+		for (auto i = 0 ; i < 64 ; i++){
+			_tileids[i] = static_cast<tileid_t>(ptr[0] | (ptr[1]<<8)) ;
+			_altitudes[i] = static_cast<std::int8_t>(ptr[2]) ;
+			ptr += 3 ;
 		}
 	}
 	//===============================================================
 	MapBlock::MapBlock(const std::vector<std::uint8_t> &data ){
-		
+		_tileids.fill(invalid_tileid);
+		_altitudes.fill(0);
 		if (!data.empty()){
 			load(data);
 		}
@@ -49,11 +58,9 @@ namespace UO{
 	std::vector<std::uint8_t> MapBlock::blockData() const {
 		Buffer buffer(196) ;
 		buffer << static_cast<std::uint32_t>(1234) ;
-		for (auto y = 0 ; y < 8 ; y++){
-			for (auto x=0 ; x<8 ; x++){
-				buffer << _data[x][y].tileid;
-				buffer << static_cast<std::int8_t>(_data[x][y].z);
-			}
+		for (auto i = 0 ; i < 64 ; i++){
+			buffer << _tileids[i];
+			buffer << _altitudes[i];
 		}
 
 		return buffer.raw();
@@ -82,11 +89,10 @@ namespace UO{
 		std::uint8_t xoffset ;
 		std::uint8_t yoffset ;
 		std::uint16_t hue ;
+		auto tiledata = UO::TileData::current() ;
 		while (buffer.position()<buffer.size()){
 			buffer >> tileid ;
-			tile_st tile ;
-			tile.tileid = tileid;
-			tile.info = UO::TileData::shared().art(tileid) ;
+			tile_st tile(tileid, tiledata->artHandle(tileid)) ;
 			buffer>>xoffset;
 			buffer >> yoffset ;
 			buffer >> altitude ;
@@ -8,24 +8,32 @@
 #include <array>
 #include <vector>
 #include "TileInfo.hpp"
+#include "MappedFile.hpp"
 namespace UO{
 	
 	//===============================================================
+	// Only the tileid and altitude of each cell is kept (3 bytes a cell), the
+	// tile information is looked up (in the tile data given) when asked for.
 	class MapBlock {
 	private:
-		
-		std::array<std::array<tile_st,8>,8> _data ; // 8 x 8 array
+		// 8 x 8, in the order of the data (row by row)
+		std::array<tileid_t,64> _tileids ;
+		std::array<std::int8_t,64> _altitudes ;
 		
 	public:
-		const tile_st& at(std::int32_t x,std::int32_t y) const ;
-		tile_st & at(std::int32_t x, std::int32_t y) ;
-		void load(const std::vector<std::uint8_t> &data);
+		tileid_t tileid(std::int32_t x,std::int32_t y) const { return _tileids[(y*8)+x];}
+		std::int8_t altitude(std::int32_t x,std::int32_t y) const { return _altitudes[(y*8)+x];}
+		const tile_info& info(std::int32_t x,std::int32_t y, const TileInfo &tiledata) const ;
+		tile_st at(std::int32_t x,std::int32_t y, const TileInfo &tiledata) const ;
+		void set(std::int32_t x, std::int32_t y, tileid_t tileid, std::int8_t altitude) ;
+		void load(const ByteSpan &data);
 		MapBlock(const std::vector<std::uint8_t> &data = std::vector<std::uint8_t>());
 		std::vector<std::uint8_t> blockData() const ;
 		
 	};
 	
 	//===============================================================
+	// The tile handles are those of the tile data current when the block is loaded
 	class StaticBlock {
 	private:
 		std::array<std::array<std::vector<tile_st>,8>,8> _data ; // 8 x 8 array
@@ -17,100 +17,84 @@ namespace UO {
 	
 	
 	//===============================================================
-	bool GumpData::processEntry(std::size_t entry, std::size_t index, const std::vector<std::uint8_t> &data) {
-		if (data.size() <=8){
-			return true ;
-		}
-		_gumps.insert_or_assign(index, data);
-		return true ;
-	}
-	//===============================================================
-	void GumpData::recordData(std::uint32_t record_number, std::uint32_t extra, std::vector<std::uint8_t> &record_data) {
-		auto height = static_cast<std::uint32_t>((extra & 0xFFFF));
-		auto width = static_cast<std::uint32_t>(((extra>>16) & 0xFFFF));
-		//The first 8 bytes of the data represent the the width
-		//(bytes 0-4) and height (bytes 4-8) of the gump
-		std::vector<std::uint8_t> tempdata(record_data.size() + 8,0);
-		
-		auto ptr = reinterpret_cast<std::uint32_t*>(tempdata.data());
-		*ptr = width ;
-		*(ptr+1) = height ;
-		std::copy(record_data.begin(),record_data.end(),tempdata.begin()+8);
-		_gumps.insert_or_assign(record_number, tempdata);
-		
-	}
-	//===============================================================
-	IMG::Bitmap GumpData::convert(const std::vector<std::uint8_t> &data) const {
-		if (data.size() <8){
-			return IMG::Bitmap(0,0);
-		}
-		auto ptr = reinterpret_cast<const std::uint32_t*>(data.data());
-		auto width = *ptr ;
-		auto height = *(ptr+1) ;
-
+	IMG::Bitmap GumpData::convert(std::uint32_t width, std::uint32_t height, const ByteSpan &data) const {
 		IMG::Bitmap bitmap(width,height,0xFFFFFF);
 		if (bitmap.empty()){
 			return bitmap ;
 		}
-		std::vector<std::uint8_t> newdata(data.size()-8,0);
-		std::copy(data.begin()+8,data.end(),newdata.begin());
-		
-		std::vector<unsigned int> lookup(height,0) ;
-		
-		std::copy(newdata.data(),newdata.data()+(height*4),reinterpret_cast<unsigned char*>(lookup.data()));
-		auto iter = lookup.begin() ;
-		auto y = 0 ;
-		while (iter != lookup.end()){
-			auto amount = (newdata.size()) - ((*iter)*4) ;
-			if ((iter+1) < lookup.end()){
-				amount = ((*(iter+1)) - (*iter)) *4 ;
-			}
-			std::vector<unsigned short> rundata(amount/2,0);
-			std::copy(newdata.data()+((*iter)*4),newdata.data()+((*iter)*4)+amount,reinterpret_cast<unsigned char*>(rundata.data()));
-			auto piter = rundata.begin() ;
-			auto x = 0 ;
-			while (piter != rundata.end()){
-				auto value = *(piter++);
-				auto run = *(piter++) ;
-				for (auto i=0 ; i< run ; i++){
-					bitmap.at(x++,height - (y+1)) = value ;
-				}
+		// Everything is in 4 byte units (row offsets, and color/run pairs)
+		auto available = data.size()/4 ;
+		if (available < height){
+			return bitmap ;
+		}
+		auto lookup = data.data() ;
+		auto offset = [lookup](std::size_t y) {
+			std::uint32_t value = 0 ;
+			std::copy(lookup + (y*4), lookup + (y*4) + 4, reinterpret_cast<std::uint8_t*>(&value));
+			return static_cast<std::size_t>(value) ;
+		};
+		for (std::size_t y = 0 ; y < height ; y++){
+			auto start = offset(y) ;
+			auto end = ((y+1) < height) ? offset(y+1) : available ;
+			end = std::min(end, available) ;
+			auto line = bitmap.line(y) ;
+			std::size_t x = 0 ;
+			for (auto entry = start ; (entry < end) && (x < width) ; entry++){
+				auto ptr = data.data() + (entry*4) ;
+				auto value = static_cast<std::uint16_t>(ptr[0] | (ptr[1]<<8)) ;
+				auto run = static_cast<std::size_t>(ptr[2] | (ptr[3]<<8)) ;
+				run = std::min(run, width - x) ;
+				std::fill(line + x, line + x + run, IMG::Color(value));
+				x += run ;
 			}
-			y++ ;
-			iter++;
 		}
 		return bitmap;
 	}
 	
 	//===============================================================
 	void GumpData::openUOP(const std::string &uopfile){
-		_gumps.clear();
-		
-		loadUOP(uopfile, 0x7FFFF ,_hash_format_1,_hash_format_2);
+		indexUOP(uopfile, 0x7FFFF ,_gumps, _hash_format_1,_hash_format_2);
+		_uop_format = true ;
+		// Anything that is just the width/height isn't a gump
+		for (std::size_t id = 0 ; id < _gumps.size(); id++){
+			if (_gumps.has(id) && (_gumps.length(id) <= 8)){
+				_gumps.remove(id);
+			}
+		}
 	}
 
 	/************************************************************************
 	 public methods
 	 ***********************************************************************/
 	std::size_t GumpData::maxGump() const {
-		if (_gumps.empty()){
-			return 0;
-		}
-		return _gumps.crbegin()->first + 1;
+		return _gumps.maxID();
 	}
 	
 	//===============================================================
 	bool GumpData::hasGump(std::size_t tileid) const {
-		return (_gumps.find(tileid) == _gumps.end())?false:true ;
+		return _gumps.has(tileid) ;
 	}
 	
 	//===============================================================
 	IMG::Bitmap GumpData::gump(std::size_t tileid) const {
-		auto iter = _gumps.find(tileid);
-		if (iter == _gumps.end()){
+		std::vector<std::uint8_t> storage ;
+		auto data = _gumps.data(tileid, storage);
+		if (_uop_format){
+			//The first 8 bytes of the data represent the the width
+			//(bytes 0-4) and height (bytes 4-8) of the gump
+			if (data.size() < 8){
+				return IMG::Bitmap(0,0);
+			}
+			auto ptr = reinterpret_cast<const std::uint32_t*>(data.data());
+			return convert(*ptr, *(ptr+1), data.subspan(8, data.size()-8));
+		}
+		if (data.empty()){
 			return IMG::Bitmap(0,0);
 		}
-		return convert(iter->second).invert();
+		auto extra = _gumps.extra(tileid);
+		auto height = static_cast<std::uint32_t>((extra & 0xFFFF));
+		auto width = static_cast<std::uint32_t>(((extra>>16) & 0xFFFF));
+		return convert(width, height, data);
 	}
 
 	
@@ -138,12 +122,12 @@ namespace UO {
 	}
 	//===============================================================
 	void GumpData::open(const std::string &idxfile, const std::string &mulfil){
-		_gumps.clear();
-		
-		processFiles(idxfile, mulfil);
+		indexFiles(idxfile, mulfil, _gumps);
+		_uop_format = false ;
 	}
 	//===============================================================
 	GumpData::GumpData(const std::string &uodir_uopfile){
+		_uop_format = false ;
 		if (uodir_uopfile.empty()){
 			return ;
 		}
@@ -151,6 +135,7 @@ namespace UO {
 	}
 	//===============================================================
 	GumpData::GumpData(const std::string &idxpath,const std::string& mulpath){
+		_uop_format = false ;
 		open(idxpath,mulpath);
 	}
 
@@ -5,12 +5,12 @@
 
 #include <string>
 #include <cstdint>
-#include <map>
 #include <vector>
 
 #include "Bitmap.hpp"
 #include "IDXMul.hpp"
 #include "UOPData.hpp"
+#include "RecordIndex.hpp"
 namespace UO {
 	//===============================================================
 	class GumpData : public IDXMul, public UOPData {
@@ -22,19 +22,18 @@ namespace UO {
 		static const std::string _idx_file ;
 		static const std::string _mul_file ;
 		
-		std::map<std::size_t,std::vector<std::uint8_t>> _gumps ;
+		RecordIndex _gumps ;
+		// The uop data has the width/height in the data, the mul has it in the idx
+		bool _uop_format ;
 		
-		bool processEntry(std::size_t entry, std::size_t index, const std::vector<std::uint8_t> &data) final;
-		void recordData(std::uint32_t record_number, std::uint32_t extra, std::vector<std::uint8_t> &record_data) final;
 		// Data format for Gumps
-		// std::uint32_t width
-		// std::uint32_t height
 		// std::uint32_t rowoffsets[height] ;
 		
 		// Row data is :
 		//		std::uint16_t color
 		//		std::utin16_t length ;
-		IMG::Bitmap convert(const std::vector<std::uint8_t> &data) const;
+		// The runs are read in place, and the rows written top down
+		IMG::Bitmap convert(std::uint32_t width, std::uint32_t height, const ByteSpan &data) const;
 
 		void openUOP(const std::string &uopfile);
 
@@ -2,8 +2,8 @@
 
 #include "IDXMul.hpp"
 #include "UOAlerts.hpp"
+#include "RecordIndex.hpp"
 #include <iostream>
-#include <fstream>
 #include <filesystem>
 
 
@@ -13,50 +13,71 @@ namespace UO {
 	//===============================================================
 	// Process the files
 	void IDXMul::processFiles(const std::string &idxpath, const std::string &mulpath){
-		std::array<std::uint32_t,3> _record ;
-		std::ifstream idx(idxpath,std::ios::binary) ;
-		if (!idx.is_open()){
+		MappedFile idx(idxpath) ;
+		if (!idx.isOpen()){
 			throw FileOpen(idxpath) ;
 		}
-		_mulfile_size = std::filesystem::file_size(std::filesystem::path(mulpath));
-		std::ifstream mul(mulpath,std::ios::binary) ;
-		if (!mul.is_open()){
+		MappedFile mul(mulpath) ;
+		if (!mul.isOpen()){
 			throw FileOpen(mulpath) ;
 		}
-		// Get the size of the idx file
-		idx.seekg(0,std::ios::end);
-		auto record_total = static_cast<std::uint32_t>(idx.tellg()/12);
-		idx.seekg(0, std::ios::beg);
+		_mulfile_size = mul.size();
+		// Get the number of records in the idx file
+		auto record_total = static_cast<std::uint32_t>(idx.size()/12);
 		// Notify the subclass the record count ;
 		entryCount(record_total);
-		std::uint32_t entry = 0 ;
-		while (!idx.eof() && idx.good()){
-			idx.read(reinterpret_cast<char*>(_record.data()),4);
-			idx.read(reinterpret_cast<char*>(_record.data()+1),4);
-			idx.read(reinterpret_cast<char*>(_record.data()+2),4);
-			if ((idx.gcount()==4) && idx.good() && !idx.eof()) {
-				// Process the record, the read was good
-				if ((_record[0]<0xFFFFFFFE) && (_record[1]>0)) {
-					// This is a valid offset into data
-					mul.seekg(_record[0],std::ios::beg) ;
-					std::vector<std::uint8_t> data(_record[1],0);
-					mul.read(reinterpret_cast<char*>(data.data()),_record[1]);
-					// Was the read good?
-					if (mul.gcount() != _record[1]) {
-						idx.close();
-						mul.close();
-						throw StreamError(mulpath);
-					}
-					//Notify the subclass about the data
-					recordData(entry, _record[2], data);
+		auto record = reinterpret_cast<const std::uint32_t*>(idx.data());
+		for (std::uint32_t entry = 0 ; entry < record_total ; entry++){
+			// offset, length, extra
+			auto offset = record[0] ;
+			auto length = record[1] ;
+			auto extra = record[2] ;
+			record += 3 ;
+			if ((offset<0xFFFFFFFE) && (length>0)) {
+				// This is a valid offset into data
+				auto data = mul.span(offset, length);
+				// Was it within the file?
+				if (data.size() != length) {
+					throw StreamError(mulpath);
 				}
+				//Notify the subclass about the data
+				recordData(entry, extra, data);
 			}
-			entry++;
 		}
-		idx.close();
-		mul.close();
 		// Notify the subclass we are through reading the data
 		readingComplete();
 	}
+	//===============================================================
+	// Index the files
+	void IDXMul::indexFiles(const std::string &idxpath, const std::string &mulpath, RecordIndex &index){
+		index.clear();
+		MappedFile idx(idxpath) ;
+		if (!idx.isOpen()){
+			throw FileOpen(idxpath) ;
+		}
+		if (!index.open(mulpath)){
+			throw FileOpen(mulpath) ;
+		}
+		_mulfile_size = std::filesystem::file_size(std::filesystem::path(mulpath));
+		auto record_total = static_cast<std::uint32_t>(idx.size()/12);
+		entryCount(record_total);
+		index.resize(record_total);
+		auto record = reinterpret_cast<const std::uint32_t*>(idx.data());
+		for (std::uint32_t entry = 0 ; entry < record_total ; entry++){
+			// offset, length, extra
+			if ((record[0]<0xFFFFFFFE) && (record[1]>0)) {
+				if (static_cast<std::uint64_t>(record[0]) + record[1] > _mulfile_size){
+					throw StreamError(mulpath);
+				}
+				record_entry value ;
+				value.offset = record[0] ;
+				value.length = record[1] ;
+				value.extra = record[2] ;
+				index.set(entry, value);
+			}
+			record += 3 ;
+		}
+		readingComplete();
+	}
 
 }
@@ -16,12 +16,19 @@
  		std::uint32_t	offset
  		std::uint32_t	length
  		std::uint32_t	extra
+ 
+ 	Both files are memory mapped while being processed, and the record data handed
+ 	to the subclass is a view directly into the mapped mul file.  That view is only
+ 	valid for the duration of the recordData call, so a subclass that wants to keep
+ 	the data must copy it.
  */
 #include <string>
 #include <cstdint>
 #include <vector>
 #include <array>
+#include "MappedFile.hpp"
 namespace UO {
+	class RecordIndex ;
 	//===============================================================
 	class IDXMul {
 	private:
@@ -35,12 +42,15 @@ namespace UO {
 		virtual void entryCount(std::uint32_t number_of_entries){};
 		
 		// Provides the data associated with the corresponding record number
-		virtual void recordData(std::uint32_t record_number, std::uint32_t extra, std::vector<std::uint8_t> &record_data)=0;
+		// (only valid for the duration of the call)
+		virtual void recordData(std::uint32_t record_number, std::uint32_t extra, const ByteSpan &record_data){};
 		// Informs the subclass that reading the data has completed
 		virtual void  readingComplete(){} ;
 		
 		// Process the files
 		void processFiles(const std::string &idxpath, const std::string &mulpath);
+		// Only index the files, the data is fetched from the index when needed
+		void indexFiles(const std::string &idxpath, const std::string &mulpath, RecordIndex &index);
 		
 	public:
 		virtual ~IDXMul() = default ;
@@ -3,7 +3,11 @@
 #include "MapArt.hpp"
 #include "StringUtility.hpp"
 #include "UOAlerts.hpp"
+#include "TileData.hpp"
+#include "ColumnFile.hpp"
 #include <iostream>
+#include <algorithm>
+#include <map>
 #include <filesystem>
 #include <fstream>
 
@@ -26,35 +30,134 @@ namespace UO {
 		_diflfile = strutil::format(_difl_file,map);
 	}
 	
+	/***********************************************************************
+	 static_tile
+	 ************************************************************************/
 	//===============================================================
-	void MapArt::recordData(std::uint32_t record_number, std::uint32_t extra, std::vector<std::uint8_t> &record_data){
-		_blocks.insert_or_assign(record_number, StaticBlock(record_data));
+	static_tile::static_tile(tileid_t tileid, std::int8_t z, std::uint16_t hue){
+		this->tileid = tileid ;
+		this->z = z ;
+		this->hue = hue ;
+	}
+	//===============================================================
+	tile_st static_tile::tile(const TileInfo &tiledata) const {
+		tile_st tile(tileid, tiledata.artHandle(tileid)) ;
+		tile.z = z ;
+		tile.isStatic = true ;
+		tile.artHue = hue ;
+		return tile ;
+	}
+
+	/***********************************************************************
+	 MapArt
+	 ************************************************************************/
+	//===============================================================
+	std::size_t MapArt::blockCount() const {
+		return static_cast<std::size_t>(_width/8) * static_cast<std::size_t>(_height/8) ;
 	}
-	
-	
 	//===============================================================
-	std::vector<tile_st>& MapArt::at(std::int32_t x, std::int32_t y)  {
+	std::size_t MapArt::cellFor(std::int32_t x, std::int32_t y) const {
 		auto blocknum = calcBlock(x, y);
-		auto iter = _blocks.find(blocknum);
-		if (iter == _blocks.end()){
-			return _empty_tiles;
-		}
-		
 		auto [xbase,ybase] = baseXY(blocknum);
-		
-		return iter->second.at(x-xbase,y-ybase);
+		return (static_cast<std::size_t>(blocknum) * 64) + ((y-ybase)*8) + (x-xbase) ;
 	}
 	//===============================================================
-	const std::vector<tile_st>& MapArt::at(std::int32_t x, std::int32_t y) const {
-		auto blocknum = calcBlock(x, y);
-		auto iter = _blocks.find(blocknum);
-		if (iter == _blocks.end()){
-			return _empty_tiles;
+	void MapArt::addBlock(std::size_t blocknum, const ByteSpan &data, std::vector<cell_static> &entries) const {
+		if (blocknum >= blockCount()){
+			return ;
 		}
-		
-		auto [xbase,ybase] = baseXY(blocknum);
-		
-		return iter->second.at(x-xbase,y-ybase);
+		auto base = static_cast<std::uint32_t>(blocknum * 64) ;
+		auto ptr = data.data() ;
+		for (std::size_t index = 0 ; (index + 7) <= data.size() ; index += 7){
+			auto tileid = static_cast<tileid_t>(ptr[index] | (ptr[index+1]<<8)) ;
+			auto xoffset = ptr[index+2] ;
+			auto yoffset = ptr[index+3] ;
+			auto altitude = static_cast<std::int8_t>(ptr[index+4]) ;
+			auto hue = static_cast<std::uint16_t>(ptr[index+5] | (ptr[index+6]<<8)) ;
+			if ((xoffset < 8) && (yoffset < 8)){
+				entries.push_back(std::make_pair(base + (yoffset*8) + xoffset, static_tile(tileid,altitude,hue)));
+			}
+		}
+	}
+	//===============================================================
+	// A counting sort on the cell, it is stable, so the statics in a cell keep
+	// the order they are in the data
+	void MapArt::build(std::vector<cell_static> &entries) {
+		auto cells = blockCount() * 64 ;
+		_offsets.assign(cells + 1, 0);
+		for (const auto &entry : entries){
+			_offsets[entry.first + 1]++ ;
+		}
+		for (std::size_t cell = 0 ; cell < cells ; cell++){
+			_offsets[cell+1] += _offsets[cell] ;
+		}
+		_statics.assign(entries.size(), static_tile());
+		auto next = std::vector<std::uint32_t>(_offsets.begin(), _offsets.end()-1);
+		for (const auto &entry : entries){
+			_statics[next[entry.first]++] = entry.second ;
+		}
+		entries.clear();
+		entries.shrink_to_fit();
+	}
+	//===============================================================
+	void MapArt::recordData(std::uint32_t record_number, std::uint32_t extra, const ByteSpan &record_data){
+		addBlock(record_number, record_data, _loading);
+	}
+	//===============================================================
+	void MapArt::readingComplete() {
+		build(_loading);
+	}
+	
+	//===============================================================
+	static_range MapArt::statics(std::int32_t x, std::int32_t y) const {
+		return cellStatics(cellFor(x, y));
+	}
+	//===============================================================
+	static_range MapArt::statics(std::int32_t blocknum, std::int32_t xoffset, std::int32_t yoffset) const {
+		return cellStatics((static_cast<std::size_t>(blocknum) * 64) + (yoffset*8) + xoffset);
+	}
+	//===============================================================
+	static_range MapArt::cellStatics(std::size_t cell) const {
+		if ((cell+1) >= _offsets.size()){
+			return static_range();
+		}
+		return static_range(_statics.data() + _offsets[cell], _statics.data() + _offsets[cell+1]);
+	}
+	//===============================================================
+	std::vector<tile_st> MapArt::at(std::int32_t x, std::int32_t y) const {
+		std::vector<tile_st> rvalue ;
+		auto range = statics(x, y) ;
+		rvalue.reserve(range.size());
+		for (const auto &entry : range){
+			rvalue.push_back(entry.tile(*_tiledata));
+		}
+		return rvalue ;
+	}
+	//===============================================================
+	void MapArt::saveColumns(const std::string &filepath) const {
+		const std::vector<column_def> columns{
+			{"x",ColumnType::uint16},{"y",ColumnType::uint16},{"z",ColumnType::int8},
+			{"tileid",ColumnType::uint16},{"hue",ColumnType::uint16}
+		};
+		ColumnWriter output(filepath, columns, staticCount()) ;
+		auto xs = output.column<std::uint16_t>(0) ;
+		auto ys = output.column<std::uint16_t>(1) ;
+		auto zs = output.column<std::int8_t>(2) ;
+		auto tileids = output.column<tileid_t>(3) ;
+		auto hues = output.column<std::uint16_t>(4) ;
+		for (std::int32_t y = 0 ; y < _height ; y++){
+			for (std::int32_t x = 0 ; x < _width ; x++){
+				for (const auto &entry : statics(x, y)){
+					auto row = output.nextRow() ;
+					xs[row] = static_cast<std::uint16_t>(x) ;
+					ys[row] = static_cast<std::uint16_t>(y) ;
+					zs[row] = entry.z ;
+					tileids[row] = entry.tileid ;
+					hues[row] = entry.hue ;
+				}
+			}
+		}
+		output.close();
 	}
 
 	//===============================================================
@@ -89,6 +192,8 @@ namespace UO {
 		}
 
 		_diffcount = 0 ;
+		// The new data for each block changed (empty if it has no statics now)
+		std::map<std::size_t,std::vector<std::uint8_t>> changed ;
 		std::uint32_t blocknumber ;
 		std::uint32_t offset ;
 		std::uint32_t length ;
@@ -99,15 +204,12 @@ namespace UO {
 				difi.read(reinterpret_cast<char*>(&length),4);
 				difi.seekg(4,std::ios::cur);
 				if ((offset ==0xFFFFFFFF) || (offset == 0xFFFFFFFE) ||(length==0)){
-					auto iter = _blocks.find(blocknumber);
-					if (iter != _blocks.end()){
-						_blocks.erase(iter);
-					}
+					changed.insert_or_assign(blocknumber, std::vector<std::uint8_t>());
 				}
 				else {
 					std::vector<std::uint8_t> data(length,0);
 					dif.read(reinterpret_cast<char*>(data.data()),data.size());
-					_blocks.insert_or_assign(blocknumber, StaticBlock(data));
+					changed.insert_or_assign(blocknumber, data);
 				}
 				_diffcount++;
 			}
@@ -115,13 +217,39 @@ namespace UO {
 		difi.close();
 		difl.close();
 		dif.close();
+		if (!changed.empty()){
+			// Rebuild, with the changed blocks in place of what was there
+			std::vector<cell_static> entries ;
+			entries.reserve(_statics.size());
+			for (std::size_t blocknum = 0 ; blocknum < blockCount() ; blocknum++){
+				auto iter = changed.find(blocknum);
+				if (iter != changed.end()){
+					addBlock(blocknum, ByteSpan(iter->second), entries);
+					continue ;
+				}
+				for (auto cell = blocknum*64 ; cell < (blocknum+1)*64 ; cell++){
+					for (auto index = _offsets[cell] ; index < _offsets[cell+1] ; index++){
+						entries.push_back(std::make_pair(static_cast<std::uint32_t>(cell), _statics[index]));
+					}
+				}
+			}
+			build(entries);
+			for (const auto &entry : changed){
+				_changed.push_back(static_cast<std::int32_t>(entry.first));
+			}
+			std::sort(_changed.begin(), _changed.end());
+			_changed.erase(std::unique(_changed.begin(), _changed.end()), _changed.end());
+		}
 		return _diffcount;
 	}
 
 	//===============================================================
 	bool MapArt::load(const std::string &idxfile,const std::string &mulfile,std::size_t mapnumber,std::int32_t width, std::int32_t height){
 		buildStrings(mapnumber);
-		_blocks.clear();
+		_offsets.clear();
+		_statics.clear();
+		_loading.clear();
+		_changed.clear();
 		_diffcount=0;
 		auto [defwidth ,defheight] =  _mapsizes[mapnumber];
 		if (width==0){
@@ -145,6 +273,15 @@ namespace UO {
 		
 		return true;
 	}
+	//===============================================================
+	MapArt::MapArt(std::shared_ptr<const TileData> tiledata) : _tiledata(std::move(tiledata)) {
+		if (_tiledata == nullptr){
+			_tiledata = TileData::current() ;
+		}
+		_width = 0 ;
+		_height = 0 ;
+		_diffcount = 0 ;
+	}
 
 
 }
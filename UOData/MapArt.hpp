@@ -6,13 +6,35 @@
 #include <string>
 #include <cstdint>
 #include <vector>
-#include <map>
 #include <utility>
+#include <memory>
 #include "UOMapBase.hpp"
 #include "Block.hpp"
 #include "IDXMul.hpp"
+#include "TileInfo.hpp"
 
 namespace UO {
+	class TileData ;
+	//===============================================================
+	// A static as stored in the map, the tile information is looked up when needed
+	struct static_tile {
+		tileid_t tileid ;
+		std::int8_t z ;
+		std::uint16_t hue ;
+		static_tile(tileid_t tileid = invalid_tileid, std::int8_t z=0, std::uint16_t hue=0);
+		tile_st tile(const TileInfo &tiledata) const ;
+	};
+	//===============================================================
+	// The statics in one cell of the map
+	struct static_range {
+		const static_tile *first ;
+		const static_tile *last ;
+		static_range(const static_tile *first=nullptr, const static_tile *last=nullptr) : first(first),last(last){}
+		const static_tile * begin() const { return first;}
+		const static_tile * end() const { return last;}
+		std::size_t size() const { return static_cast<std::size_t>(last-first);}
+		bool empty() const { return first == last ;}
+	};
 	//===============================================================
 	class MapArt : public IDXMul, public UOMapBase {
 		
@@ -29,31 +51,63 @@ namespace UO {
 		std::string _diflfile ;
 		std::string _dififile ;
 		
-		std::vector<tile_st> _empty_tiles;
-		
-		std::map<std::size_t , StaticBlock> _blocks ;
+		// Compressed sparse rows: the statics of every cell (blocks in order, 64 cells
+		// a block, row by row in the block) are in one array, and _offsets[cell] to
+		// _offsets[cell+1] is the range of a cell.
+		std::vector<std::uint32_t> _offsets ;
+		std::vector<static_tile> _statics ;
+		// While loading, the statics and the cell they belong to
+		using cell_static = std::pair<std::uint32_t,static_tile> ;
+		std::vector<cell_static> _loading ;
 		
 		std::size_t _diffcount ;
+		// The blocks changed by diffs
+		std::vector<std::int32_t> _changed ;
+		// What the tile handles are resolved with
+		std::shared_ptr<const TileData> _tiledata ;
 		
 		void buildStrings(std::size_t mapnumber) ;
+		std::size_t blockCount() const ;
+		std::size_t cellFor(std::int32_t x, std::int32_t y) const ;
+		static_range cellStatics(std::size_t cell) const ;
+		
+		// Static data is 7 bytes per static
+		//		std::uint16_t tileid
+		//		std::uint8_t x (in the block)
+		//		std::uint8_t y (in the block)
+		//		std::int8_t z
+		//		std::uint16_t hue
+		void addBlock(std::size_t blocknum, const ByteSpan &data, std::vector<cell_static> &entries) const ;
+		void build(std::vector<cell_static> &entries) ;
 		
-		void recordData(std::uint32_t record_number, std::uint32_t extra, std::vector<std::uint8_t> &record_data) final;
+		void recordData(std::uint32_t record_number, std::uint32_t extra, const ByteSpan &record_data) final;
+		void readingComplete() final ;
 		
 	public:
 		
 		std::int32_t mapArtWidth()const {return _width;}
 		std::int32_t mapArtHeight()const {return _height;} 
 		
-		std::vector<tile_st>& at(std::int32_t x, std::int32_t y)  ;
-		const std::vector<tile_st>& at(std::int32_t x, std::int32_t y) const ;
+		static_range statics(std::int32_t x, std::int32_t y) const ;
+		// The statics of a cell in a block (offsets are 0-7 in the block)
+		static_range statics(std::int32_t blocknum, std::int32_t xoffset, std::int32_t yoffset) const ;
+		// The statics with their tile information
+		std::vector<tile_st> at(std::int32_t x, std::int32_t y) const ;
+		std::size_t staticCount() const { return _statics.size();}
+		// A column file (x, y, z, tileid, hue) with a row for every static, in map order
+		// (y, then x, then the order in the cell)
+		void saveColumns(const std::string &filepath) const ;
 
 		std::size_t applyDiff(const std::string &difflfile,const std::string &diffifile,const std::string &difffile);
 		
 		std::size_t diffCount() const {return _diffcount;}
+		// The blocks that were changed by diffs
+		std::vector<std::int32_t> changedBlocks() const {return _changed;}
 
 		bool load(const std::string &idxfile,const std::string &mulfile,std::size_t mapnumber,std::int32_t width=0, std::int32_t height=0);
-		
-		UO::StaticBlock& block(std::size_t number){return _blocks[number];}
+		// Without tiledata, the tile data current when the map is made
+		MapArt(std::shared_ptr<const TileData> tiledata = nullptr);
+		const std::shared_ptr<const TileData> & tileData() const { return _tiledata;}
 
 	};
 	
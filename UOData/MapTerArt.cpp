@@ -4,14 +4,20 @@
 #include "TileInfo.hpp"
 #include "StringUtility.hpp"
 #include "RadarColor.hpp"
+#include "TileData.hpp"
+#include "WorkQueue.hpp"
+#include "UOAlerts.hpp"
+#include <functional>
 #include <filesystem>
 #include <iostream>
+#include <fstream>
 #include <algorithm>
+#include <array>
 
 using namespace std::string_literals;
 namespace UO {
 	//===============================================================
-	MapTerArt::MapTerArt(std::size_t mapnumber,std::int32_t width, std::int32_t height){
+	MapTerArt::MapTerArt(std::size_t mapnumber,std::int32_t width, std::int32_t height) : _tiledata(TileData::current()), _terrain(_tiledata), _art(_tiledata) {
 		_mapnumber = mapnumber ;
 		auto [defwidth,defheight] = _mapsizes[_mapnumber];
 		if (width == 0) {
@@ -51,13 +57,17 @@ namespace UO {
 	//===============================================================
 	std::vector<tile_st> MapTerArt::tiles(std::int32_t x, std::int32_t y,bool sort_height) const {
 		std::vector<tile_st> alltiles ;
+		auto arttiles = _art.statics(x,y) ;
+		alltiles.reserve(arttiles.size()+1);
 		alltiles.push_back(_terrain.at(x,y));
-		auto arttiles = _art.at(x,y) ;
-		for (const auto &tile:arttiles){
-			alltiles.push_back(tile);
+		for (const auto &entry:arttiles){
+			alltiles.push_back(entry.tile(*_tiledata));
 		}
 		if (sort_height){
-			std::sort(alltiles.rbegin(),alltiles.rend());
+			const TileInfo &tiledata = *_tiledata ;
+			std::sort(alltiles.rbegin(),alltiles.rend(),[&tiledata](const UO::tile_st &a,const UO::tile_st &b){
+				return a.lowerTop(b, tiledata);
+			});
 		}
 		else {
 			std::sort(alltiles.rbegin(),alltiles.rend(),[](const UO::tile_st &a,const UO::tile_st &b){
@@ -67,43 +77,303 @@ namespace UO {
 		return  alltiles;
 	}
 	//===============================================================
-	const tile_st& MapTerArt::terrain(std::int32_t x, std::int32_t y) const {
+	tile_st MapTerArt::terrain(std::int32_t x, std::int32_t y) const {
 		return _terrain.at(x,y);
 	}
 	//===============================================================
-	tile_st& MapTerArt::terrain(std::int32_t x, std::int32_t y){
-		return _terrain.at(x,y);
+	tileid_t MapTerArt::terrainID(std::int32_t x, std::int32_t y) const {
+		return _terrain.tileid(x,y);
 	}
 	//===============================================================
-	std::vector<tile_st>& MapTerArt::art(std::int32_t x, std::int32_t y) {
-		return _art.at(x,y);
+	std::int8_t MapTerArt::terrainAltitude(std::int32_t x, std::int32_t y) const {
+		return _terrain.altitude(x,y);
+	}
+	//===============================================================
+	void MapTerArt::setTerrain(std::int32_t x, std::int32_t y, tileid_t tileid, std::int8_t altitude){
+		_terrain.set(x,y,tileid,altitude);
 	}
 	//===============================================================
-	const std::vector<tile_st>& MapTerArt::art(std::int32_t x, std::int32_t y) const{
+	std::vector<tile_st> MapTerArt::art(std::int32_t x, std::int32_t y) const{
 		return _art.at(x,y);
 	}
+	//===============================================================
+	static_range MapTerArt::statics(std::int32_t x, std::int32_t y) const{
+		return _art.statics(x,y);
+	}
+	
+	//===============================================================
+	void MapTerArt::saveTerrainColumns(const std::string &filepath) const {
+		_terrain.saveColumns(filepath);
+	}
+	//===============================================================
+	void MapTerArt::saveArtColumns(const std::string &filepath) const {
+		_art.saveColumns(filepath);
+	}
 	
 	//===============================================================
-	IMG::Bitmap MapTerArt::radar(const RadarColor &palette,bool include_art){
-		if (!include_art){
-			return _terrain.radar(palette);
+	MapTerArt::tile_heights::tile_heights(const TileInfo &tiledata){
+		terrain.resize(tiledata.sizeTerrain(),0);
+		for (std::size_t tileid = 0 ; tileid < terrain.size(); tileid++){
+			terrain[tileid] = tiledata.terrain(tileid).height ;
 		}
-		else {
-			IMG::Bitmap bitmap(_width,_height,0);
-			for (auto y=0;y<_height;y++){
-				for (auto x=0; x<_width;x++){
-					auto alltiles = tiles(x,y,true) ;
-					if (alltiles[0].info.type==UO::TileType::art){
-						bitmap.at(x,y)= palette[alltiles[0].tileid+0x4000];
-					}
-					else {
-						bitmap.at(x,y)= palette[alltiles[0].tileid];
+		art.resize(tiledata.sizeArt(),0);
+		for (std::size_t tileid = 0 ; tileid < art.size(); tileid++){
+			art[tileid] = tiledata.art(tileid).height ;
+		}
+	}
+	//===============================================================
+	// The top tile is the first (terrain, then the statics in order) with the
+	// highest altitude+height
+	void MapTerArt::radarBlock(const RadarColor &palette, const tile_heights &heights, std::int32_t blocknum, IMG::Color *pixels, std::size_t stride, bool include_art) const {
+		auto block = _terrain.block(blocknum);
+		auto [xbase,ybase] = baseXY(blocknum);
+		auto columns = std::min(8, _width - xbase) ;
+		auto rows = std::min(8, _height - ybase) ;
+		for (auto yoffset = 0 ; yoffset < rows ; yoffset++){
+			auto row = pixels + (yoffset * stride) ;
+			for (auto xoffset = 0 ; xoffset < columns ; xoffset++){
+				std::size_t color = block.tileid(xoffset,yoffset) ;
+				if (include_art){
+					std::int32_t top = block.altitude(xoffset, yoffset) + ((color < heights.terrain.size()) ? heights.terrain[color] : 0) ;
+					for (const auto &entry : _art.statics(blocknum, xoffset, yoffset)){
+						std::int32_t value = entry.z + ((entry.tileid < heights.art.size()) ? heights.art[entry.tileid] : 0) ;
+						auto higher = value > top ;
+						top = higher ? value : top ;
+						color = higher ? (entry.tileid + 0x4000) : color ;
 					}
 				}
+				row[xoffset] = palette[color] ;
+			}
+		}
+	}
+	//===============================================================
+	void MapTerArt::radarBlockRows(const RadarColor &palette, const tile_heights &heights, std::int32_t first, std::int32_t last, IMG::Color *pixels, bool include_art, WorkQueue *queue) const {
+		auto width = static_cast<std::size_t>(_width) ;
+		auto columns = (_width + 7) / 8 ;
+		for (auto blockrow = first ; blockrow < last ; blockrow++){
+			auto origin = pixels + ((blockrow - first) * 8 * width) ;
+			auto task = [this,&palette,&heights,blockrow,origin,columns,width,include_art](){
+				for (auto column = 0 ; column < columns ; column++){
+					radarBlock(palette, heights, calcBlock(column*8, blockrow*8), origin + (column*8), width, include_art);
+				}
+			};
+			if (queue == nullptr){
+				task();
+			}
+			else {
+				queue->add(task);
+			}
+		}
+		if (queue != nullptr){
+			queue->wait();
+		}
+	}
+	//===============================================================
+	IMG::Bitmap MapTerArt::radar(const RadarColor &palette,bool include_art, WorkQueue *queue) const{
+		IMG::Bitmap bitmap(_width,_height,0);
+		if (bitmap.empty()){
+			return bitmap ;
+		}
+		tile_heights heights(*_tiledata) ;
+		radarBlockRows(palette, heights, 0, (_height + 7)/8, bitmap.line(0), include_art, queue);
+		return bitmap;
+	}
+	//===============================================================
+	void MapTerArt::radarRow(const RadarColor &palette, std::int32_t y, IMG::Color *row, bool include_art) const {
+		// Each block on the row is rendered (as radar() does), and its row copied
+		tile_heights heights(*_tiledata) ;
+		std::array<IMG::Color,64> block ;
+		auto yoffset = y % 8 ;
+		for (auto x = 0 ; x < _width ; x += 8){
+			radarBlock(palette, heights, calcBlock(x, y), block.data(), 8, include_art);
+			std::copy(block.begin() + (yoffset * 8), block.begin() + (yoffset * 8) + std::min(8, _width - x), row + x);
+		}
+	}
+	//===============================================================
+	// The bmp is written bottom up, so the bands are rendered from the bottom of
+	// the map.  A band is padded to whole blocks.
+	void MapTerArt::saveRadar(const std::string &filepath, const RadarColor &palette,bool include_art, WorkQueue *queue) const {
+		constexpr std::int32_t band_blocks = 8 ;
+		tile_heights heights(*_tiledata) ;
+		auto width = static_cast<std::size_t>(_width) ;
+		std::vector<IMG::Color> band(width * band_blocks * 8) ;
+		std::int32_t band_first = -1 ;	// the first block row in the band
+		IMG::Bitmap::saveBMP(filepath, _width, _height, [&](std::size_t y, IMG::Color * /*scratch*/){
+			auto blockrow = static_cast<std::int32_t>(y / 8) ;
+			if ((band_first < 0) || (blockrow < band_first) || (blockrow >= (band_first + band_blocks))){
+				band_first = std::max(0, blockrow - (band_blocks - 1)) ;
+				radarBlockRows(palette, heights, band_first, blockrow + 1, band.data(), include_art, queue);
+			}
+			return band.data() + ((y - (band_first * 8)) * width) ;
+		});
+	}
+	
+	//===============================================================
+	std::vector<std::int32_t> MapTerArt::changedBlocks() const {
+		auto rvalue = _terrain.changedBlocks() ;
+		auto art = _art.changedBlocks() ;
+		rvalue.insert(rvalue.end(), art.begin(), art.end());
+		std::sort(rvalue.begin(), rvalue.end());
+		rvalue.erase(std::unique(rvalue.begin(), rvalue.end()), rvalue.end());
+		return rvalue ;
+	}
+	//===============================================================
+	std::size_t MapTerArt::radarLevels(std::size_t tilesize) const {
+		auto size = static_cast<std::size_t>(std::max(_width, _height)) ;
+		std::size_t levels = 1 ;
+		while ((tilesize << (levels-1)) < size){
+			levels++ ;
+		}
+		return levels ;
+	}
+	//===============================================================
+	std::string MapTerArt::radarTilePath(const std::string &directory, std::size_t level, std::int32_t x, std::int32_t y) const {
+		auto path = std::filesystem::path(directory) / std::filesystem::path(std::to_string(level)) / std::filesystem::path(std::to_string(x)) ;
+		return (path / std::filesystem::path(std::to_string(y) + ".bmp"s)).string() ;
+	}
+	//===============================================================
+	void MapTerArt::radarTiles(const std::string &directory, const RadarColor &palette, std::size_t tilesize, bool include_art, WorkQueue *queue, const tile_set *changed) const {
+		tilesize = std::max<std::size_t>(8, ((tilesize + 7)/8)*8) ;
+		auto levels = radarLevels(tilesize) ;
+		tile_heights heights(*_tiledata) ;
+		auto run = [queue](const std::function<void()> &task){
+			if (queue == nullptr){
+				task();
+			}
+			else {
+				queue->add(task);
+			}
+		};
+		// The tiles in a level, either all of them, or the ones changed
+		auto tilesFor = [this,tilesize](std::size_t scale, const tile_set *subset){
+			if (subset != nullptr){
+				return *subset ;
+			}
+			tile_set tiles ;
+			auto span = static_cast<std::int32_t>(tilesize * scale) ;
+			for (auto x = 0 ; x < (_width + span - 1)/span ; x++){
+				for (auto y = 0 ; y < (_height + span - 1)/span ; y++){
+					tiles.push_back(std::make_pair(x,y));
+				}
 			}
-			return bitmap;
+			return tiles ;
+		};
+		auto makeDirectories = [this,&directory](std::size_t level, const tile_set &tiles){
+			for (const auto &[x,y] : tiles){
+				std::filesystem::create_directories(std::filesystem::path(radarTilePath(directory, level, x, y)).parent_path());
+			}
+		};
+		
+		// Full size, from the map
+		auto tiles = tilesFor(1, changed) ;
+		makeDirectories(levels-1, tiles);
+		for (const auto &[tilex,tiley] : tiles){
+			run([this,&directory,&palette,&heights,levels,tilesize,include_art,tilex = tilex,tiley = tiley](){
+				IMG::Bitmap bitmap(tilesize,tilesize,0);
+				auto xorigin = static_cast<std::int32_t>(tilex * tilesize) ;
+				auto yorigin = static_cast<std::int32_t>(tiley * tilesize) ;
+				for (std::size_t yoffset = 0 ; yoffset < tilesize ; yoffset += 8){
+					for (std::size_t xoffset = 0 ; xoffset < tilesize ; xoffset += 8){
+						auto x = xorigin + static_cast<std::int32_t>(xoffset) ;
+						auto y = yorigin + static_cast<std::int32_t>(yoffset) ;
+						if ((x < _width) && (y < _height)){
+							radarBlock(palette, heights, calcBlock(x, y), bitmap.line(yoffset) + xoffset, tilesize, include_art);
+						}
+					}
+				}
+				bitmap.save(radarTilePath(directory, levels-1, tilex, tiley));
+			});
+		}
+		if (queue != nullptr){
+			queue->wait();
 		}
 		
+		// Each level above, from the four tiles under each tile
+		for (auto level = levels - 1 ; level > 0 ; level--){
+			tile_set parents ;
+			if (changed != nullptr){
+				for (const auto &[x,y] : tiles){
+					parents.push_back(std::make_pair(x/2, y/2));
+				}
+				std::sort(parents.begin(), parents.end());
+				parents.erase(std::unique(parents.begin(), parents.end()), parents.end());
+			}
+			tiles = tilesFor(std::size_t(1) << (levels - level), (changed != nullptr) ? &parents : nullptr) ;
+			makeDirectories(level-1, tiles);
+			auto below = std::size_t(1) << (levels - 1 - level) ; // the scale of the level below
+			auto span = static_cast<std::int32_t>(tilesize * below) ;
+			auto columns = (_width + span - 1)/span ;
+			auto rows = (_height + span - 1)/span ;
+			for (const auto &[tilex,tiley] : tiles){
+				run([this,&directory,tilesize,level,columns,rows,tilex = tilex,tiley = tiley](){
+					IMG::Bitmap bitmap(tilesize,tilesize,0);
+					for (auto quadrant = 0 ; quadrant < 4 ; quadrant++){
+						auto x = (tilex*2) + (quadrant%2) ;
+						auto y = (tiley*2) + (quadrant/2) ;
+						if ((x < columns) && (y < rows)){
+							IMG::Bitmap child ;
+							child.open(radarTilePath(directory, level, x, y), IMG::Bitmap::FileType::bmp);
+							bitmap.paste(child.reduce(), (quadrant%2)*(tilesize/2), (quadrant/2)*(tilesize/2));
+						}
+					}
+					// 24 bit, so the averages are not cut back to 5 bits a channel at each level
+					bitmap.save(radarTilePath(directory, level-1, tilex, tiley), IMG::Bitmap::FileType::bmp, 24);
+				});
+			}
+			if (queue != nullptr){
+				queue->wait();
+			}
+		}
+	}
+	//===============================================================
+	std::string MapTerArt::changedBlocksPath(const std::string &directory) const {
+		return (std::filesystem::path(directory) / std::filesystem::path("changed.blocks"s)).string() ;
+	}
+	//===============================================================
+	std::vector<std::int32_t> MapTerArt::readChangedBlocks(const std::string &directory) const {
+		std::vector<std::int32_t> rvalue ;
+		std::ifstream input(changedBlocksPath(directory));
+		std::int32_t blocknum = 0 ;
+		while (input >> blocknum){
+			rvalue.push_back(blocknum);
+		}
+		return rvalue ;
+	}
+	//===============================================================
+	void MapTerArt::writeChangedBlocks(const std::string &directory, const std::vector<std::int32_t> &blocks) const {
+		auto filepath = changedBlocksPath(directory) ;
+		std::ofstream output(filepath);
+		if (!output.is_open()){
+			throw FileOpen(filepath);
+		}
+		for (auto blocknum : blocks){
+			output << blocknum << "\n";
+		}
+	}
+	//===============================================================
+	void MapTerArt::saveRadarTiles(const std::string &directory, const RadarColor &palette, std::size_t tilesize, bool include_art, WorkQueue *queue) const {
+		radarTiles(directory, palette, tilesize, include_art, queue, nullptr);
+		writeChangedBlocks(directory, changedBlocks());
+	}
+	//===============================================================
+	void MapTerArt::updateRadarTiles(const std::string &directory, const RadarColor &palette, std::size_t tilesize, bool include_art, WorkQueue *queue) const {
+		tilesize = std::max<std::size_t>(8, ((tilesize + 7)/8)*8) ;
+		// The blocks changed now, and those changed the last time (as their diffs may be gone)
+		auto current = changedBlocks() ;
+		auto blocks = readChangedBlocks(directory) ;
+		blocks.insert(blocks.end(), current.begin(), current.end());
+		tile_set tiles ;
+		for (auto blocknum : blocks){
+			auto [x,y] = baseXY(blocknum);
+			if ((x < _width) && (y < _height)){
+				tiles.push_back(std::make_pair(x / static_cast<std::int32_t>(tilesize), y / static_cast<std::int32_t>(tilesize)));
+			}
+		}
+		std::sort(tiles.begin(), tiles.end());
+		tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+		if (!tiles.empty()){
+			radarTiles(directory, palette, tilesize, include_art, queue, &tiles);
+		}
+		writeChangedBlocks(directory, current);
 	}
-
 }
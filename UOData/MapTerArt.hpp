@@ -5,24 +5,58 @@
 
 #include <string>
 #include <cstdint>
+#include <vector>
+#include <utility>
+#include <memory>
 
 #include "MapTerrain.hpp"
 #include "MapArt.hpp"
 #include "UOMapBase.hpp"
 #include "Bitmap.hpp"
+
+class WorkQueue ;
 namespace UO {
 	struct tile_st ;
+	class TileData ;
 	class RadarColor;
 	//===============================================================
 	class MapTerArt : public UOMapBase{
 	private:
+		// The terrain and art both resolve tiles with it
+		std::shared_ptr<const TileData> _tiledata ;
 		MapTerrain _terrain ;
 		MapArt _art ;
 		
 		std::size_t _mapnumber ;
 		
+		// The height (from the tile data) of each terrain and art tile, so the top
+		// tile of a cell can be found from the tileids alone
+		struct tile_heights {
+			std::vector<std::int16_t> terrain ;
+			std::vector<std::int16_t> art ;
+			tile_heights(const TileInfo &tiledata);
+		};
+		// Renders the 8x8 block into pixels (stride is the pixels in a row of
+		// pixels), only the part of the block that is in the map
+		void radarBlock(const RadarColor &palette, const tile_heights &heights, std::int32_t blocknum, IMG::Color *pixels, std::size_t stride, bool include_art) const ;
+		// Renders the rows of blocks [first,last) into pixels (that is the first row)
+		void radarBlockRows(const RadarColor &palette, const tile_heights &heights, std::int32_t first, std::int32_t last, IMG::Color *pixels, bool include_art, WorkQueue *queue) const ;
+		
+		// Radar tiles, level 0 is the whole map in one tile, each level after doubles
+		// the size, to radarLevels()-1 which is full size (a pixel per cell)
+		using tile_set = std::vector<std::pair<std::int32_t,std::int32_t>> ;
+		std::string radarTilePath(const std::string &directory, std::size_t level, std::int32_t x, std::int32_t y) const ;
+		void radarTiles(const std::string &directory, const RadarColor &palette, std::size_t tilesize, bool include_art, WorkQueue *queue, const tile_set *changed) const ;
+		// The blocks changed by diffs when the tiles in directory were made
+		std::string changedBlocksPath(const std::string &directory) const ;
+		std::vector<std::int32_t> readChangedBlocks(const std::string &directory) const ;
+		void writeChangedBlocks(const std::string &directory, const std::vector<std::int32_t> &blocks) const ;
+		
 	public:
+		// The map holds the tile data current when it is made (so load that first), a
+		// TileData::reload() does not change what it sees
 		MapTerArt(std::size_t mapnumber,std::int32_t width, std::int32_t height) ;
+		const std::shared_ptr<const TileData> & tileData() const { return _tiledata;}
 		
 		void load(const std::string &uodir) ;
 		void loadTerrain(const std::string &mapmul_uop);
@@ -44,13 +78,44 @@ namespace UO {
 		// by altitude+height.
 		std::vector<tile_st> tiles(std::int32_t x, std::int32_t y,bool sort_height=false) const ;
 		
-		const tile_st& terrain(std::int32_t x, std::int32_t y) const ;
-		tile_st& terrain(std::int32_t x, std::int32_t y);
+		tile_st terrain(std::int32_t x, std::int32_t y) const ;
+		// Just the tileid and altitude, without the tile information
+		tileid_t terrainID(std::int32_t x, std::int32_t y) const ;
+		std::int8_t terrainAltitude(std::int32_t x, std::int32_t y) const ;
+		void setTerrain(std::int32_t x, std::int32_t y, tileid_t tileid, std::int8_t altitude);
 		
-		std::vector<tile_st>& art(std::int32_t x, std::int32_t y) ;
-		const std::vector<tile_st>& art(std::int32_t x, std::int32_t y) const ;
+		std::vector<tile_st> art(std::int32_t x, std::int32_t y) const ;
+		static_range statics(std::int32_t x, std::int32_t y) const ;
+		// Column files of the terrain (x, y, z, tileid) and statics (x, y, z, tileid, hue),
+		// see ColumnFile.hpp.  The tile information is in TileInfo's column files.
+		void saveTerrainColumns(const std::string &filepath) const ;
+		void saveArtColumns(const std::string &filepath) const ;
 
-		IMG::Bitmap radar(const RadarColor &palette,bool include_art = true);
+		// The radar color of a cell is that of its top tile (altitude + height).  The
+		// map is rendered a block at a time, and with a queue the rows of blocks are
+		// split across its threads (so do not call these from a task on that queue).
+		IMG::Bitmap radar(const RadarColor &palette,bool include_art = true, WorkQueue *queue = nullptr) const ;
+		// Fills row (mapWidth() long) with the radar colors for row y of the map (the
+		// same colors radar() gives)
+		void radarRow(const RadarColor &palette, std::int32_t y, IMG::Color *row, bool include_art = true) const ;
+		// Writes the radar map as a bmp, a band of block rows at a time
+		void saveRadar(const std::string &filepath, const RadarColor &palette,bool include_art = true, WorkQueue *queue = nullptr) const ;
+		
+		// The blocks changed by diffs (terrain or art)
+		std::vector<std::int32_t> changedBlocks() const ;
+		// The radar map as a pyramid of tiles (tilesize, a multiple of 8, square), for
+		// map viewers: directory/level/x/y.bmp.  The full size tiles are rendered from
+		// the map, and each level above is made from the four tiles below it (read
+		// back), so the full image is never in memory.  The full size tiles are 16 bit
+		// bmps (as the map colors are), the levels above 24 bit.  With a queue, the
+		// tiles of a level are split across its threads.
+		std::size_t radarLevels(std::size_t tilesize = 256) const ;
+		void saveRadarTiles(const std::string &directory, const RadarColor &palette, std::size_t tilesize = 256, bool include_art = true, WorkQueue *queue = nullptr) const ;
+		// The blocks changed by diffs when the tiles were made are kept in
+		// directory/changed.blocks.  An update only makes the tiles (and the tiles above
+		// them) that contain a block changed now or then (its diff may have been
+		// removed), the rest of the pyramid is expected to be there from saveRadarTiles.
+		void updateRadarTiles(const std::string &directory, const RadarColor &palette, std::size_t tilesize = 256, bool include_art = true, WorkQueue *queue = nullptr) const ;
 	};
 }
 
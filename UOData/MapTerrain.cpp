@@ -8,9 +8,10 @@
 #include <filesystem>
 #include <algorithm>
 #include "UOAlerts.hpp"
-#include "Buffer.hpp"
 #include "RadarColor.hpp"
 #include "TileInfo.hpp"
+#include "TileData.hpp"
+#include "ColumnFile.hpp"
 using namespace std::string_literals;
 namespace UO {
 	//===============================================================
@@ -32,46 +33,62 @@ namespace UO {
 	}
 
 	//===============================================================
-	void MapTerrain::processBlock(std::size_t blocknum, const std::vector<std::uint8_t> &data){
+	std::size_t MapTerrain::blockCount() const {
+		return static_cast<std::size_t>(_width/8) * static_cast<std::size_t>(_height/8) ;
+	}
+	//===============================================================
+	const std::uint8_t * MapTerrain::mappedBlock(std::size_t blocknum) const {
+		if (!_mapped.isOpen() || (!_changed.empty() && (_changed.find(blocknum) != _changed.end()))){
+			return nullptr ;
+		}
+		auto offset = blocknum * _block_size ;
+		if ((offset + _block_size) > _mapped.size()){
+			return nullptr ;
+		}
+		return _mapped.data() + offset ;
+	}
+	//===============================================================
+	const MapBlock * MapTerrain::storedBlock(std::size_t blocknum) const {
+		// Blocks past the end of the data, are empty (as if never loaded)
+		static const MapBlock empty_block ;
+		if (!_changed.empty()){
+			auto iter = _changed.find(blocknum);
+			if (iter != _changed.end()){
+				return &(iter->second) ;
+			}
+		}
+		if (blocknum < _blocks.size()){
+			return &_blocks[blocknum] ;
+		}
+		return &empty_block ;
+	}
+	//===============================================================
+	void MapTerrain::processBlock(std::size_t blocknum, const ByteSpan &data){
 		if (blocknum < _blocks.size()){
-			//std::cout <<"Processing block " << blocknum << std::endl;
-			_blocks[blocknum] = MapBlock(data);
+			_blocks[blocknum].load(data);
 		}
 	}
 	//===============================================================
 	bool MapTerrain::processEntry(std::size_t entry, std::size_t index, const std::vector<std::uint8_t> &data) {
-		//
 		auto block = index * 4096 ;
-		std::vector<std::uint8_t> blockdata(196);
-		std::size_t offset = 0 ;
-		while (offset < data.size()) {
-			std::copy(data.begin()+offset,data.begin()+offset+blockdata.size(),blockdata.begin()) ;
-			processBlock(block,blockdata);
+		auto source = ByteSpan(data) ;
+		for (std::size_t offset = 0 ; (offset + _block_size) <= source.size() ; offset += _block_size){
+			processBlock(block, source.subspan(offset, _block_size)) ;
 			block++ ;
-			offset += blockdata.size() ;
 		}
-		
-		
 		return true ;
 	}
 	
 	//===============================================================
+	// The mul is a fixed size array of blocks, so it is mapped and used in place
 	void MapTerrain::readMul(const std::string &mulpath){
 		_usedUOP = false ;
 		_diffcount = 0;
-		std::ifstream input(mulpath,std::ios::binary) ;
-		if (!input.is_open()){
+		_blocks.clear();
+		_blocks.shrink_to_fit();
+		if (!_mapped.open(mulpath)){
 			throw FileOpen(mulpath);
 		}
-		std::vector<std::uint8_t> chunk(196,0);
-		std::size_t blocknum = 0 ;
-		while (!input.eof() && input.good()){
-			input.read(reinterpret_cast<char*>(chunk.data()),196);
-			if (input.gcount()== 196){
-				processBlock(blocknum, chunk);
-				blocknum++;
-			}
-		}
 	}
 
 	//===============================================================
@@ -95,14 +112,16 @@ namespace UO {
 		if (!diff.is_open()){
 			throw FileOpen(diffpath.string());
 		}
-		std::vector<std::uint8_t> dif_data(196,0);
+		std::vector<std::uint8_t> dif_data(_block_size,0);
 		_diffcount = 0 ;
 		std::uint32_t blocknumber ;
 		while (!diffl.eof() && diffl.good()){
 			diffl.read(reinterpret_cast<char*>(&blocknumber),4);
 			if (diffl.gcount()==4){
-				diff.read(reinterpret_cast<char*>(dif_data.data()),196);
-				_blocks[blocknumber] = MapBlock(dif_data);
+				diff.read(reinterpret_cast<char*>(dif_data.data()),dif_data.size());
+				if (blocknumber < blockCount()){
+					_changed.insert_or_assign(blocknumber, MapBlock(dif_data));
+				}
 				_diffcount++;
 			}
 		}
@@ -111,12 +130,33 @@ namespace UO {
 		return _diffcount;
 	}
 	
+	//===============================================================
+	std::vector<std::int32_t> MapTerrain::changedBlocks() const {
+		std::vector<std::int32_t> rvalue ;
+		rvalue.reserve(_changed.size());
+		for (const auto &entry : _changed){
+			rvalue.push_back(static_cast<std::int32_t>(entry.first));
+		}
+		std::sort(rvalue.begin(), rvalue.end());
+		return rvalue ;
+	}
+	
+	//===============================================================
+	MapTerrain::MapTerrain(std::shared_ptr<const TileData> tiledata) : _tiledata(std::move(tiledata)) {
+		if (_tiledata == nullptr){
+			_tiledata = TileData::current() ;
+		}
+		_usedUOP = false ;
+		_diffcount = 0 ;
+	}
 	//===============================================================
 	bool MapTerrain::load(const std::string &datapath,std::size_t mapnumber,std::int32_t width, std::int32_t height){
 		_usedUOP = true;
 		_diffcount = 0 ;
 		buildStrings(mapnumber);
 		_blocks.clear();
+		_changed.clear();
+		_mapped.close();
 		auto [def_width,def_height] = _mapsizes[mapnumber];
 		if (width == 0 ){
 			width = def_width;
@@ -126,14 +166,13 @@ namespace UO {
 		}
 		_width = width ;
 		_height = height ;
-		_blocks.clear() ;
-		_blocks.resize((width/8) * (height/8));
 		auto path = std::filesystem::path(datapath) ;
 		if (std::filesystem::is_directory(path)){
 			// It is a directory!
 			// Try UOP first
 			auto uoppath = path / std::filesystem::path(_uopfile) ;
 			if (std::filesystem::exists(uoppath)){
+				_blocks.resize(blockCount());
 				loadUOP(uoppath.string(), 0x300 , _hashformat);
 			}
 			else {
@@ -142,8 +181,9 @@ namespace UO {
 			}
 			
 		}
-		if (path.extension()== ".uop"s){
+		else if (path.extension()== ".uop"s){
 			// it is an uop!
+			_blocks.resize(blockCount());
 			loadUOP(path.string(), 0x300 , _hashformat);
 		}
 		else {
@@ -154,31 +194,116 @@ namespace UO {
 	}
 	
 	//===============================================================
-	tile_st& MapTerrain::at(std::int32_t x, std::int32_t y)  {
+	tileid_t MapTerrain::tileid(std::int32_t x, std::int32_t y) const {
 		auto blocknum = calcBlock(x, y);
-		//std::cout <<"blocknum was " << blocknum << std::endl;
 		auto [xbase,ybase] = baseXY(blocknum);
-		//std::cout << "xbase is "<<xbase << " ybase is " <<ybase << std::endl;
-		return (_blocks[blocknum]).at(x-xbase,y-ybase);
+		auto data = mappedBlock(blocknum) ;
+		if (data != nullptr){
+			auto cell = data + 4 + ((((y-ybase)*8) + (x-xbase)) * 3) ;
+			return static_cast<tileid_t>(cell[0] | (cell[1]<<8)) ;
+		}
+		return storedBlock(blocknum)->tileid(x-xbase,y-ybase);
 	}
 	//===============================================================
-	const tile_st& MapTerrain::at(std::int32_t x, std::int32_t y)  const {
+	std::int8_t MapTerrain::altitude(std::int32_t x, std::int32_t y) const {
 		auto blocknum = calcBlock(x, y);
-		//std::cout <<"blocknum was " << blocknum << std::endl;
 		auto [xbase,ybase] = baseXY(blocknum);
-		//std::cout << "xbase is "<<xbase << " ybase is " <<ybase << std::endl;
-		return (_blocks[blocknum]).at(x-xbase,y-ybase);
+		auto data = mappedBlock(blocknum) ;
+		if (data != nullptr){
+			auto cell = data + 4 + ((((y-ybase)*8) + (x-xbase)) * 3) ;
+			return static_cast<std::int8_t>(cell[2]) ;
+		}
+		return storedBlock(blocknum)->altitude(x-xbase,y-ybase);
+	}
+	//===============================================================
+	const tile_info& MapTerrain::info(std::int32_t x, std::int32_t y) const {
+		auto id = tileid(x, y) ;
+		if (id == invalid_tileid){
+			static const tile_info empty_info ;
+			return empty_info ;
+		}
+		return _tiledata->terrain(id);
+	}
+	//===============================================================
+	tile_st MapTerrain::at(std::int32_t x, std::int32_t y)  const {
+		auto id = tileid(x,y) ;
+		tile_st tile(id, (id == invalid_tileid) ? invalid_handle : _tiledata->terrainHandle(id)) ;
+		tile.z = altitude(x,y) ;
+		return tile ;
+	}
+	//===============================================================
+	void MapTerrain::saveColumns(const std::string &filepath) const {
+		const std::vector<column_def> columns{
+			{"x",ColumnType::uint16},{"y",ColumnType::uint16},{"z",ColumnType::int8},{"tileid",ColumnType::uint16}
+		};
+		ColumnWriter output(filepath, columns, static_cast<std::uint64_t>(_width) * _height) ;
+		auto xs = output.column<std::uint16_t>(0) ;
+		auto ys = output.column<std::uint16_t>(1) ;
+		auto zs = output.column<std::int8_t>(2) ;
+		auto tileids = output.column<tileid_t>(3) ;
+		// A row of blocks at a time, so each block is only looked up once
+		std::vector<MapBlock> blocks((_width + 7) / 8) ;
+		for (std::int32_t ybase = 0 ; ybase < _height ; ybase += 8){
+			for (std::int32_t xbase = 0 ; xbase < _width ; xbase += 8){
+				blocks[xbase/8] = block(calcBlock(xbase, ybase));
+			}
+			for (auto y = ybase ; y < std::min(ybase + 8, _height) ; y++){
+				for (std::int32_t x = 0 ; x < _width ; x++){
+					const auto &entry = blocks[x/8] ;
+					auto row = output.nextRow() ;
+					xs[row] = static_cast<std::uint16_t>(x) ;
+					ys[row] = static_cast<std::uint16_t>(y) ;
+					zs[row] = entry.altitude(x % 8, y - ybase) ;
+					tileids[row] = entry.tileid(x % 8, y - ybase) ;
+				}
+			}
+		}
+		output.close();
+	}
+	//===============================================================
+	MapBlock MapTerrain::block(std::int32_t blocknum) const {
+		auto data = mappedBlock(blocknum) ;
+		if (data != nullptr){
+			MapBlock block ;
+			block.load(ByteSpan(data, _block_size));
+			return block ;
+		}
+		return *storedBlock(blocknum) ;
+	}
+	//===============================================================
+	void MapTerrain::set(std::int32_t x, std::int32_t y, tileid_t tileid, std::int8_t altitude) {
+		auto blocknum = calcBlock(x, y);
+		auto [xbase,ybase] = baseXY(blocknum);
+		if (_mapped.isOpen()){
+			// The mapped file is read only, so the block is copied to the changed blocks
+			auto iter = _changed.find(blocknum);
+			if (iter == _changed.end()){
+				MapBlock block ;
+				auto data = mappedBlock(blocknum) ;
+				if (data != nullptr){
+					block.load(ByteSpan(data, _block_size));
+				}
+				iter = _changed.insert_or_assign(blocknum, block).first;
+			}
+			iter->second.set(x-xbase,y-ybase,tileid,altitude);
+		}
+		else if (blocknum < static_cast<std::int32_t>(_blocks.size())){
+			auto iter = _changed.find(blocknum);
+			if (iter != _changed.end()){
+				iter->second.set(x-xbase,y-ybase,tileid,altitude);
+			}
+			else {
+				_blocks[blocknum].set(x-xbase,y-ybase,tileid,altitude);
+			}
+		}
 	}
 	//===============================================================
-	IMG::Bitmap MapTerrain::radar(const RadarColor &radar)  {
-		//std::cout <<"Block width "<<_width/8 <<" block height " << _height/8 << std::endl;
+	IMG::Bitmap MapTerrain::radar(const RadarColor &radar) const {
 		IMG::Bitmap bitmap(_width,_height,0xffffff) ;
 		for (auto y=0; y< _height;y++){
+			auto line = bitmap.line(y) ;
 			for (auto x=0;x<_width;x++){
-				auto tile = at(x,y) ;
-				//std::cout <<"name: "<<tile.info.name <<" id " << strutil::numtostr(tile.tileid,16,true,4)<< std::endl;
-				//auto color = radar[tile.tileid];
-				bitmap.at(x,y) = radar[at(x,y).tileid];
+				line[x] = radar[tileid(x,y)];
 			}
 		}
 		return bitmap;
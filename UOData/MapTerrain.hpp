@@ -8,13 +8,18 @@
 #include <vector>
 #include <array>
 #include <utility>
+#include <unordered_map>
+#include <memory>
 #include "UOMapBase.hpp"
+#include "MappedFile.hpp"
 #include "Block.hpp"
 #include "UOPData.hpp"
 #include "Bitmap.hpp"
+#include "TileInfo.hpp"
 namespace UO {
 	class RadarColor;
 	struct tile_st ;
+	class TileData ;
 	//===============================================================
 	class MapTerrain : public UOPData, public UOMapBase {
 		
@@ -34,30 +39,58 @@ namespace UO {
 		
 		void buildStrings(std::size_t mapnumber);
 		
+		// A mul map is used in place (mapped), the blocks are a fixed size array in
+		// the file.  A uop map is read into _blocks.
+		MappedFile _mapped ;
 		std::vector<MapBlock> _blocks ;
+		// Blocks that replace the ones in the map (diffs, or changed with set())
+		std::unordered_map<std::size_t,MapBlock> _changed ;
 		bool _usedUOP ;
 		
 		std::size_t _diffcount ;
+		// What the tile handles are resolved with
+		std::shared_ptr<const TileData> _tiledata ;
+		
+		static constexpr std::size_t _block_size = 196 ;
+		std::size_t blockCount() const ;
+		// Returns the block data if the block is from the mapped file (and not changed)
+		const std::uint8_t * mappedBlock(std::size_t blocknum) const ;
+		// The block, if it is not in the mapped file
+		const MapBlock * storedBlock(std::size_t blocknum) const ;
 		
 	protected:
 		
-		void processBlock(std::size_t blocknum, const std::vector<std::uint8_t> &data);
+		void processBlock(std::size_t blocknum, const ByteSpan &data);
 		
 		bool processEntry(std::size_t entry, std::size_t index, const std::vector<std::uint8_t> &data) final ;
 
 		void readMul(const std::string &mulpath);
 	public:
+		// Without tiledata, the tile data current when the map is made
+		MapTerrain(std::shared_ptr<const TileData> tiledata = nullptr) ;
+		const std::shared_ptr<const TileData> & tileData() const { return _tiledata;}
 		bool uop() const {return _usedUOP;}
+		bool mapped() const {return _mapped.isOpen();}
 
 		std::size_t applyDiff(const std::string &difflfile,const std::string &difffile);
 		std::size_t diffCount() const {return _diffcount;}
+		// The blocks that differ from the map data (diffs, or set())
+		std::vector<std::int32_t> changedBlocks() const ;
 
 		bool load(const std::string &datapath,std::size_t mapnumber,std::int32_t width=0, std::int32_t height=0);
 		
-		tile_st& at(std::int32_t x, std::int32_t y)  ;
-		const tile_st& at(std::int32_t x, std::int32_t y) const ;
+		// Only the tileid and altitude are stored, at() builds the full tile
+		tileid_t tileid(std::int32_t x, std::int32_t y) const ;
+		std::int8_t altitude(std::int32_t x, std::int32_t y) const ;
+		const tile_info& info(std::int32_t x, std::int32_t y) const ;
+		tile_st at(std::int32_t x, std::int32_t y) const ;
+		// A copy of the block (the tileid/altitude of its 64 cells)
+		MapBlock block(std::int32_t blocknum) const ;
+		void set(std::int32_t x, std::int32_t y, tileid_t tileid, std::int8_t altitude) ;
+		// A column file (x, y, z, tileid) with a row for every cell, in map order (y, then x)
+		void saveColumns(const std::string &filepath) const ;
 		
-		IMG::Bitmap radar(const RadarColor &radar) ;
+		IMG::Bitmap radar(const RadarColor &radar) const ;
 	};
 	
 }
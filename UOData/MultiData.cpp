@@ -34,7 +34,7 @@ namespace UO {
 			multi_st component ;
 			component.flag = 0 ;
 			component.tileid  = (*reinterpret_cast<const std::uint16_t *>((data.data()+offset))) ;
-			component.info = TileData::shared().art(component.tileid);
+			component.handle = _tiledata->artHandle(component.tileid);
 			offset = offset + 2 ;
 			component.x = (*reinterpret_cast<const std::int16_t *>((data.data()+offset))) ;
 			offset = offset + 2 ;
@@ -104,20 +104,20 @@ namespace UO {
 	// IDX overrides
 	//===============================================================
 	// Provides the data associated with the corresponding record number
-	void MultiData::recordData(std::uint32_t record_number, std::uint32_t extra, std::vector<std::uint8_t> &record_data){
+	void MultiData::recordData(std::uint32_t record_number, std::uint32_t extra, const ByteSpan &record_data){
 		if (record_data.empty()){
 			return ;
 		}
 		multi_structure structure ;
 		structure.name = nameForID(record_number);
-		Buffer buffer(record_data) ;
+		Buffer buffer(record_data.data(),record_data.size()) ;
 		std::int16_t value16;
 		std::uint32_t flag32 ;
 		std::uint64_t flag64 ;
 		while (buffer.position() < buffer.size()){
 			multi_st multi ;
 			buffer >> multi.tileid ;
-			multi.info = TileData::shared().art(multi.tileid);
+			multi.handle = _tiledata->artHandle(multi.tileid);
 			buffer >> value16 ;
 			multi.x = value16;
 			buffer >> value16 ;
@@ -202,11 +202,11 @@ namespace UO {
 		return multi_structure();
 	}
 	//===============================================================
-	MultiData::MultiData(const std::string &uodir_uopfile){
+	MultiData::MultiData(const std::string &uodir_uopfile) : _tiledata(TileData::current()) {
 		load(uodir_uopfile);
 	}
 	//===============================================================
-	MultiData::MultiData(const std::string &idxpath,const std::string &mulpath){
+	MultiData::MultiData(const std::string &idxpath,const std::string &mulpath) : _tiledata(TileData::current()) {
 		load(idxpath,mulpath);
 	}
 
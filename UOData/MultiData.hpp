@@ -8,10 +8,12 @@
 #include <map>
 #include <vector>
 #include <array>
+#include <memory>
 #include "UOPData.hpp"
 #include "IDXMul.hpp"
 #include "TileInfo.hpp"
 namespace UO {
+	class TileData ;
 	//===============================================================
 	class MultiData : public IDXMul, public UOPData {
 	private:
@@ -25,6 +27,8 @@ namespace UO {
 		std::map<std::size_t,multi_structure> _multis;
 		bool _useHS ;
 		std::string _multicollection_file ;
+		// What the tile handles of the components are resolved with
+		std::shared_ptr<const TileData> _tiledata ;
 		std::string nameForID(std::size_t id) const ;
 		void saveMultiCollectoin(const std::vector<std::uint8_t> &data);
 	protected:
@@ -33,10 +37,12 @@ namespace UO {
 		bool processEntry(std::size_t entry, std::size_t index, const std::vector<std::uint8_t> &data)final;
 		bool processHash(std::uint64_t hash,std::size_t entry , const std::vector<std::uint8_t> &data) final;
 		bool nonIndexHash(std::uint64_t hash, std::size_t entry, const std::vector<std::uint8_t> &data) final;
+		// Each multi is stored by its index, so the order they arrive in doesn't matter
+		bool entryOrderIndependent() const final { return true;}
 
 		// IDX overrides
 		// Provides the data associated with the corresponding record number
-		void recordData(std::uint32_t record_number, std::uint32_t extra, std::vector<std::uint8_t> &record_data) final;
+		void recordData(std::uint32_t record_number, std::uint32_t extra, const ByteSpan &record_data) final;
 
 	public:
 		std::size_t maxID() const ;
@@ -44,8 +50,11 @@ namespace UO {
 		multi_structure multiFor(std::uint16_t multiid) const ;
 		std::map<std::size_t,multi_structure> allMultis() const ;
 		
+		// The multis hold the tile data current when the MultiData is made (so load
+		// that first), a TileData::reload() does not change what they see
 		MultiData(const std::string &uodir_uopfile = "");
 		MultiData(const std::string &idxpath,const std::string &mulpath);
+		const std::shared_ptr<const TileData> & tileData() const { return _tiledata;}
 
 		std::string multiCollectionBin() const ;
 		void multiCollectionBin(const std::string &filename) ;
@@ -0,0 +1,158 @@
+//Copyright © 2021 Charles Kerr. All rights reserved.
+
+#include "RecordIndex.hpp"
+#include "UOAlerts.hpp"
+#include <algorithm>
+#include <zlib.h>
+
+using namespace std::string_literals;
+namespace UO {
+	/*************************************************************************
+	 record_entry methods
+	 ************************************************************************/
+	//===============================================================
+	record_entry::record_entry(){
+		offset = 0 ;
+		length = 0 ;
+		decompressed_length = 0 ;
+		extra = 0 ;
+		compression = 0 ;
+	}
+	//===============================================================
+	bool record_entry::valid() const {
+		return length > 0 ;
+	}
+
+	/*************************************************************************
+	 RecordIndex methods
+	 ************************************************************************/
+	//===============================================================
+	void RecordIndex::clear() {
+		_file.close();
+		_entries.clear();
+		_replaced.clear();
+	}
+	//===============================================================
+	bool RecordIndex::open(const std::string &datapath){
+		return _file.open(datapath);
+	}
+	//===============================================================
+	void RecordIndex::resize(std::size_t count){
+		_entries.resize(count);
+	}
+	//===============================================================
+	void RecordIndex::set(std::size_t id, const record_entry &entry){
+		if (id >= _entries.size()){
+			_entries.resize(id+1);
+		}
+		_entries[id] = entry ;
+	}
+	//===============================================================
+	bool RecordIndex::has(std::size_t id) const {
+		return (id < _entries.size()) && _entries[id].valid() ;
+	}
+	//===============================================================
+	std::size_t RecordIndex::maxID(std::size_t first, std::size_t last) const {
+		if ((last == 0) || (last > _entries.size())){
+			last = _entries.size();
+		}
+		for (auto id = last ; id > first ; id--){
+			if (_entries[id-1].valid()){
+				return id ;
+			}
+		}
+		return first ;
+	}
+	//===============================================================
+	std::uint32_t RecordIndex::extra(std::size_t id) const {
+		if (!has(id)){
+			return 0 ;
+		}
+		return _entries[id].extra ;
+	}
+	//===============================================================
+	std::uint32_t RecordIndex::length(std::size_t id) const {
+		if (!has(id)){
+			return 0 ;
+		}
+		const auto &entry = _entries[id] ;
+		return (entry.compression == 1) ? entry.decompressed_length : entry.length ;
+	}
+	//===============================================================
+	ByteSpan RecordIndex::data(std::size_t id, std::vector<std::uint8_t> &storage) const {
+		if (!has(id)){
+			return ByteSpan();
+		}
+		auto iter = _replaced.find(id);
+		if (iter != _replaced.end()){
+			return ByteSpan(iter->second);
+		}
+		const auto &entry = _entries[id] ;
+		auto source = _file.span(entry.offset, entry.length);
+		if (source.size() != entry.length){
+			throw StreamError();
+		}
+		if (entry.compression != 1){
+			return source ;
+		}
+		// uLongf is from zlib.h
+		auto srcsize = static_cast<uLong>(source.size()) ;
+		auto destsize = static_cast<uLongf>(entry.decompressed_length);
+		storage.resize(entry.decompressed_length);
+		auto status = uncompress2(storage.data(), &destsize, source.data(), &srcsize);
+		if (status != Z_OK){
+			// Corrupt data, not an empty record
+			storage.clear();
+			throw StreamError();
+		}
+		storage.resize(destsize);
+		return ByteSpan(storage);
+	}
+	//===============================================================
+	std::vector<std::size_t> RecordIndex::fileOrder() const {
+		std::vector<std::size_t> rvalue ;
+		for (std::size_t id = 0 ; id < _entries.size(); id++){
+			if (_entries[id].valid()){
+				rvalue.push_back(id);
+			}
+		}
+		auto key = [this](std::size_t id){
+			auto replaced = _replaced.find(id) != _replaced.end() ;
+			return std::make_pair(replaced, _entries[id].offset);
+		};
+		std::stable_sort(rvalue.begin(), rvalue.end(), [&key](std::size_t lhs, std::size_t rhs){
+			return key(lhs) < key(rhs);
+		});
+		return rvalue ;
+	}
+	//===============================================================
+	void RecordIndex::release(std::size_t id) const {
+		if (!has(id) || (_replaced.find(id) != _replaced.end())){
+			return ;
+		}
+		const auto &entry = _entries[id] ;
+		_file.release(entry.offset, entry.length);
+	}
+	//===============================================================
+	void RecordIndex::replace(std::size_t id, const std::vector<std::uint8_t> &data, std::uint32_t extra){
+		if (data.empty()){
+			remove(id);
+			return ;
+		}
+		record_entry entry ;
+		entry.length = static_cast<std::uint32_t>(data.size()) ;
+		entry.extra = extra ;
+		set(id, entry);
+		_replaced.insert_or_assign(id, data);
+	}
+	//===============================================================
+	void RecordIndex::remove(std::size_t id){
+		if (id < _entries.size()){
+			_entries[id] = record_entry();
+		}
+		auto iter = _replaced.find(id);
+		if (iter != _replaced.end()){
+			_replaced.erase(iter);
+		}
+	}
+}
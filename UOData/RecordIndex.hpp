@@ -0,0 +1,68 @@
+//Copyright © 2021 Charles Kerr. All rights reserved.
+
+#ifndef RecordIndex_hpp
+#define RecordIndex_hpp
+/*******************************************************************************
+ 	A flat index of where each record lives in a data file (mul or uop).
+
+ 	Only the location information is kept (offset, length, extra, compression),
+ 	the data file itself is memory mapped.  The record data is only fetched (and
+ 	decompressed if need be) when it is asked for.  Records can also be
+ 	replaced, in which case the replacement data is held by the index.
+ ******************************************************************************/
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <map>
+#include "MappedFile.hpp"
+
+namespace UO {
+	//===============================================================
+	struct record_entry {
+		std::uint64_t offset ;
+		std::uint32_t length ;				// Length of the data in the file
+		std::uint32_t decompressed_length ;	// Only meaningful if compressed
+		std::uint32_t extra ;
+		std::int16_t compression ;			// 0 = none, 1 = zlib
+		record_entry();
+		bool valid() const ;
+	};
+
+	//===============================================================
+	class RecordIndex {
+	private:
+		MappedFile _file ;
+		std::vector<record_entry> _entries ;
+		std::map<std::size_t,std::vector<std::uint8_t>> _replaced ;
+
+	public:
+		void clear() ;
+		bool open(const std::string &datapath) ;
+
+		void resize(std::size_t count) ;
+		void set(std::size_t id, const record_entry &entry);
+
+		std::size_t size() const { return _entries.size();}
+		bool has(std::size_t id) const ;
+		// The highest valid id (plus one) in the range [first,last)
+		std::size_t maxID(std::size_t first=0, std::size_t last=0) const ;
+		std::uint32_t extra(std::size_t id) const ;
+		// The length of the record data (after any decompression)
+		std::uint32_t length(std::size_t id) const ;
+
+		// Returns the data for the record.  If the data has to be decompressed
+		// the returned span refers to storage, otherwise it refers to the mapped
+		// file (or the replacement data held by the index).  Throws StreamError if
+		// the data can not be read (or decompressed).
+		ByteSpan data(std::size_t id, std::vector<std::uint8_t> &storage) const ;
+		// The valid ids in the order their data is in the file (replaced records last),
+		// so visiting them in this order reads the file sequentially
+		std::vector<std::size_t> fileOrder() const ;
+		// Lets the system drop the mapped pages of the record once it has been used
+		void release(std::size_t id) const ;
+
+		void replace(std::size_t id, const std::vector<std::uint8_t> &data, std::uint32_t extra=0);
+		void remove(std::size_t id);
+	};
+}
+#endif /* RecordIndex_hpp */
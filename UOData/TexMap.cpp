@@ -16,14 +16,7 @@ namespace UO {
 
 
 	//===============================================================
-	void TexMap::recordData(std::uint32_t record_number, std::uint32_t extra, std::vector<std::uint8_t> &record_data){
-		if (!record_data.empty()){
-			_data.insert_or_assign(record_number, record_data);
-		}
-	}
-
-	//===============================================================
-	IMG::Bitmap TexMap::convertData( const std::vector<std::uint8_t> &data )const  {
+	IMG::Bitmap TexMap::convertData( const ByteSpan &data )const  {
 		auto width = 0 ;
 		if (data.size() == 0x8000) {
 			width = 128 ;
@@ -35,14 +28,9 @@ namespace UO {
 			return IMG::Bitmap(0,0);
 		}
 		auto height = width ;
-		Buffer buffer(data) ;
 		IMG::Bitmap bitmap(width,height);
-		for (auto y = 0 ; y < height;y++){
-			for (auto x= 0 ; x<width;x++){
-				auto value = buffer.read<std::uint16_t>() ;
-				bitmap.at(x,y) = IMG::Color(value);
-			}
-		}
+		// The rows are contiguous in both
+		IMG::Color::fromUO(reinterpret_cast<const std::uint16_t*>(data.data()), bitmap.line(0), width*height);
 		return bitmap ;
 	}
 	//===============================================================
@@ -75,37 +63,24 @@ namespace UO {
 	
 	//===============================================================
 	std::size_t TexMap::maxTexid() const {
-		if (_data.empty()){
-			return 0;
-		}
-		auto iter = _data.crbegin();
-		return iter->first + 1 ;
+		return _data.maxID();
 	}
 	//===============================================================
 	bool TexMap::hasTexture(std::size_t tileid) const {
-		auto iter = _data.find(tileid);
-		if (iter != _data.end()){
-			return true;
-		}
-		return false ;
+		return _data.has(tileid);
 	}
 	//===============================================================
 	IMG::Bitmap TexMap::texture(std::size_t tileid) const {
 		if (!hasTexture(tileid)){
 			return IMG::Bitmap(0,0);
 		}
-		auto iter = _data.find(tileid) ;
-		return convertData(iter->second);
+		std::vector<std::uint8_t> storage ;
+		return convertData(_data.data(tileid, storage));
 	}
 	//===============================================================
 	void TexMap::texture(std::size_t tileid, const IMG::Bitmap & bitmap){
-		if (bitmap.empty()){
-			auto iter = _data.find(tileid);
-			if (iter != _data.end()){
-				_data.erase(iter);
-			}
-		}
-		_data.insert_or_assign(tileid, convertData(bitmap));
+		// An empty bitmap (or one of an unsupported size) removes the texture
+		_data.replace(tileid, convertData(bitmap));
 	}
 
 	//===============================================================
@@ -125,8 +100,7 @@ namespace UO {
 		if (!std::filesystem::exists(idxpath) || !std::filesystem::exists(mulpath) ){
 			return false ;
 		}
-		_data.clear();
-		processFiles(idxfile, mulfile);
+		indexFiles(idxfile, mulfile, _data);
 		return true;
 	}
 
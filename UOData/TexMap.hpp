@@ -6,8 +6,8 @@
 #include <string>
 #include <cstdint>
 #include "IDXMul.hpp"
+#include "RecordIndex.hpp"
 
-#include <map>
 #include <vector>
 
 #include "Bitmap.hpp"
@@ -18,11 +18,9 @@ namespace UO {
 		static const std::string _idx_file ;
 		static const std::string _mul_file ;
 		
-		std::map<std::size_t,std::vector<std::uint8_t>> _data ;
-		// Provides the data associated with the corresponding record number
-		void recordData(std::uint32_t record_number, std::uint32_t extra, std::vector<std::uint8_t> &record_data) final;
+		RecordIndex _data ;
 
-		IMG::Bitmap convertData(const std::vector<std::uint8_t> &data) const ;
+		IMG::Bitmap convertData(const ByteSpan &data) const ;
 		std::vector<std::uint8_t> convertData(const IMG::Bitmap &bitmap) const ;
 		
 	public:
@@ -1,11 +1,19 @@
 //Copyright © 2021 Charles Kerr. All rights reserved.
 
 #include "TileData.hpp"
+#include "Snapshot.hpp"
 #include <iostream>
 #include <algorithm>
+#include <mutex>
 
 using namespace std::string_literals;
 namespace UO {
+	//===============================================================
+	// The published tile data.  Readers only load it, the lock orders the first
+	// load and the reloads.
+	static Snapshot<TileData> _current ;
+	static std::mutex _publish_lock ;
+
 	//===============================================================
 	TileData::TileData(const std::string &uodir_tiledata){
 		if (!uodir_tiledata.empty()){
@@ -14,13 +22,25 @@ namespace UO {
 	}
 	
 	//===============================================================
-	TileData & TileData::shared(const std::string & input){
-		static TileData instance(input);
-		return instance ;
+	std::shared_ptr<const TileData> TileData::current(const std::string & input){
+		auto tiledata = _current.get() ;
+		if (tiledata == nullptr){
+			std::lock_guard<std::mutex> lock(_publish_lock);
+			tiledata = _current.get() ;
+			if (tiledata == nullptr){
+				tiledata = std::shared_ptr<const TileData>(new TileData(input)) ;
+				_current.publish(tiledata);
+			}
+		}
+		return tiledata ;
 	}
 	//===============================================================
-	bool TileData::read(const std::string &uodir_tiledata){
-		return load(uodir_tiledata);
+	std::shared_ptr<const TileData> TileData::reload(const std::string &uodir_tiledata){
+		// Built before the lock, so only the swap is serialized
+		auto tiledata = std::shared_ptr<const TileData>(new TileData(uodir_tiledata)) ;
+		std::lock_guard<std::mutex> lock(_publish_lock);
+		_current.publish(tiledata);
+		return tiledata ;
 	}
 	//===============================================================
 	bool TileData::HS() const { return _usedHS;}
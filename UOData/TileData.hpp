@@ -5,10 +5,17 @@
 
 #include <string>
 #include <cstdint>
+#include <memory>
 
 #include "TileInfo.hpp"
 namespace UO {
 	//===============================================================
+	// The tile data the rest of the library uses.  A TileData is loaded once and
+	// then only read, so it can be read from any thread without locking.  The
+	// maps and MultiData hold the TileData current when they are made, and the
+	// handles in the tile_st/multi_st they hand out are resolved with it (their
+	// tileData()).  reload() builds a new one and swaps it in without blocking
+	// readers, a replaced TileData is freed when the last of those lets go of it.
 	class TileData : public TileInfo {
 	private:
 		TileData(const std::string &uodir_tiledata);
@@ -16,8 +23,10 @@ namespace UO {
 		TileData(const TileData&) = delete ;
 		TileData & operator=(const TileData&) = delete;
 		
-		static TileData & shared(const std::string & input="");
-		bool read(const std::string &uodir_tiledata);
+		// The newest tile data.  If none has been loaded, it is loaded from input
+		// (if given), otherwise it is empty.
+		static std::shared_ptr<const TileData> current(const std::string & input="");
+		static std::shared_ptr<const TileData> reload(const std::string &uodir_tiledata) ;
 		
 		bool HS() const ;
 		
@@ -3,11 +3,16 @@
 #include "TileInfo.hpp"
 #include "StringUtility.hpp"
 #include "UOAlerts.hpp"
+#include "ColumnFile.hpp"
+#include "MappedFile.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <sstream>
+#include <cstring>
+#include <unordered_map>
 using namespace std::string_literals;
 namespace UO {
 	const std::array<std::string,64> tile_info::_flag_names={
@@ -167,15 +172,15 @@ namespace UO {
 	//===============================================================
 	tile_st::tile_st() {
 		tileid = invalid_tileid ;
-		info  = tile_info() ;
+		handle = invalid_handle ;
 		z = 0;
 		artHue = 0 ;
 		isStatic = false ;
 
 	}
 	//===============================================================
-	tile_st::tile_st(tileid_t tileid) {
-		info  = tile_info() ;
+	tile_st::tile_st(tileid_t tileid, tile_handle handle) {
+		this->handle = handle ;
 		z = 0;
 		artHue = 0 ;
 		isStatic = false ;
@@ -183,12 +188,16 @@ namespace UO {
 		
 	}
 	//===============================================================
+	const tile_info & tile_st::info(const TileInfo &tiledata) const {
+		return tiledata.info(handle);
+	}
+	//===============================================================
 	bool tile_st::lowerAltitude( const tile_st &rhs) const {
 		return this->z < rhs.z ;
 	}
 	//===============================================================
-	bool tile_st::operator<(const tile_st &rhs) const {
-		return (this->z+this->info.height) < (rhs.z+rhs.info.height);
+	bool tile_st::lowerTop(const tile_st &rhs, const TileInfo &tiledata) const {
+		return (this->z+this->info(tiledata).height) < (rhs.z+rhs.info(tiledata).height);
 	}
 
 	/************************************************************************
@@ -198,7 +207,7 @@ namespace UO {
 	//===============================================================
 	multi_st::multi_st(){
 		tileid = invalid_tileid;
-		info = tile_info();
+		handle = invalid_handle ;
 		x =0 ;
 		y = 0;
 		z =0 ;
@@ -209,6 +218,10 @@ namespace UO {
 		this->tileid = tileid ;
 	}
 	//===============================================================
+	const tile_info & multi_st::info(const TileInfo &tiledata) const {
+		return tiledata.info(handle);
+	}
+	//===============================================================
 	multi_structure::multi_structure(){
 		multiID = 0;
 		min_y =0;
@@ -242,130 +255,98 @@ namespace UO {
 	
 	
 	//===============================================================
-	void TileInfo::loadTerrain(const std::string &pathname, std::ifstream &input){
-		_terrain.clear();
-		_terrain.reserve(0x4000);
-		std::uint32_t value32 = 0 ;
-		std::uint64_t value64 =  0;
-		char string_buffer[21];
+	// Reads the tile data from memory, and interns the names as it goes
+	struct TileInfo::tile_reader {
+		static constexpr std::size_t name_size = 20 ;
+		ByteSpan data ;
+		std::size_t offset ;
+		std::string pathname ;
+		std::string &names ;
+		std::unordered_map<std::string_view,std::uint32_t> interned ;
 
+		tile_reader(const ByteSpan &data, const std::string &pathname, std::string &names) : data(data),offset(0),pathname(pathname),names(names) {}
+		bool has(std::size_t size) const { return (data.size() - offset) >= size ;}
+		void skip(std::size_t size) { offset += size ;}
+		template <typename T>
+		T read() {
+			T value ;
+			std::memcpy(&value, data.data() + offset, sizeof(T));
+			offset += sizeof(T) ;
+			return value ;
+		}
+		std::uint64_t readFlag(bool hs) {
+			return hs ? read<std::uint64_t>() : static_cast<std::uint64_t>(read<std::uint32_t>()) ;
+		}
+		// The name is nul terminated (or name_size long).  Returns where it is in names.
+		std::uint32_t readName() {
+			auto ptr = reinterpret_cast<const char*>(data.data() + offset) ;
+			auto name = std::string_view(ptr, static_cast<std::size_t>(std::find(ptr, ptr + name_size, 0) - ptr)) ;
+			offset += name_size ;
+			auto iter = interned.find(name) ;
+			if (iter != interned.end()){
+				return iter->second ;
+			}
+			auto location = static_cast<std::uint32_t>(names.size()) ;
+			names.append(name);
+			names.push_back(0);
+			interned.insert_or_assign(name, location);
+			return location ;
+		}
+	};
+	//===============================================================
+	TileInfo::TileInfo() {
+		_terrain_count = 0 ;
+		_usedHS = false ;
+	}
+	//===============================================================
+	void TileInfo::loadTerrain(tile_reader &reader, std::vector<std::uint32_t> &names){
+		_tiles.reserve(0x4000 + 0xFFFF);
+		auto record_size = (_usedHS ? 8 : 4) + 2 + tile_reader::name_size ;
 		for (auto i = 0 ; i < 0x4000; i++){
-			
-			if (_usedHS) {
-				if ( (((i & 0x1F)==0) && (i>0)) || (i == 1)){
-					input.read(reinterpret_cast<char*>(&value32),4); // read off the group header
-				}
+			// The group headers are skipped
+			auto header = _usedHS ? ((((i & 0x1F)==0) && (i>0)) || (i == 1)) : ((i & 0x1f) == 0) ;
+			if (!reader.has((header ? 4 : 0) + record_size)){
+				throw StreamError(reader.pathname);
 			}
-			else {
-				if ( (i & 0x1f) == 0) {
-					input.read(reinterpret_cast<char*>(&value32),4); // read off the group header
-				}
+			if (header){
+				reader.skip(4);
 			}
 			tile_info info(TileType::terrain) ;
-			
-			if (_usedHS) {
-				input.read(reinterpret_cast<char*>(&value64),8);
-				info.flag = value64 ;
-				
-			}
-			
-			else{
-				input.read(reinterpret_cast<char*>(&value32),4);
-				info.flag = value32 ;
-			}
-			
-			input.read(reinterpret_cast<char*>(&info.texture),2);
-			input.read(string_buffer,20);
-			string_buffer[input.gcount()]=0 ;
-			info.name = std::string(string_buffer) ;
-			if (input.good() && !input.eof()){
-				_terrain.push_back(info);
-			}
-			else {
-				throw StreamError(pathname);
-			}
-			
+			info.flag = reader.readFlag(_usedHS) ;
+			info.texture = reader.read<tileid_t>() ;
+			names.push_back(reader.readName());
+			_tiles.push_back(info);
 		}
-
-		
+		_terrain_count = _tiles.size() ;
 	}
 	//===============================================================
-	void TileInfo::loadArt(const std::string &pathname, std::ifstream &input){
-		_art.clear() ;
-		_art.reserve(0xFFFE) ;
-		char string_buffer[21];
-		std::uint32_t  value32 = 0 ;
-		std::uint64_t value64 = 0;
-		std::uint8_t value8 = 0 ;
-		std::uint16_t value16 = 0;
-
-		auto loopcount = 0;
-		do {
-			
-			
-			if (input.eof()) {
-				break;
+	void TileInfo::loadArt(tile_reader &reader, std::vector<std::uint32_t> &names){
+		auto record_size = (_usedHS ? 8 : 4) + 13 + tile_reader::name_size ;
+		// Only whole records are kept
+		for (auto loopcount = 0 ; ; loopcount++){
+			auto header = (loopcount & 0x1f) == 0 ;
+			if (!reader.has((header ? 4 : 0) + record_size)){
+				break ;
 			}
-			if ( (loopcount & 0x1f) == 0) {
-				input.read(reinterpret_cast<char*>(&value32),4); // read off the group header
+			if (header){
+				reader.skip(4);
 			}
-			tile_info  info(TileType::art) ;
-			if (_usedHS) {
-				input.read(reinterpret_cast<char*>(&value64),8);
-				info.flag = value64;
-				
-			}
-			else {
-				input.read(reinterpret_cast<char*>(&value32),4);
-				info.flag = static_cast<unsigned long long>(value32);
-				
-			}
-			
-			input.read(reinterpret_cast<char*>(&value8),1);
-			info.weight = value8;
-			input.read(reinterpret_cast<char*>(&value8),1);
-			info.quality = value8 ;
-			//misc data
-			input.read(reinterpret_cast<char*>(&value16),2);
-			info.miscData = value16 ;
-			//Second unkown
-			input.read(reinterpret_cast<char*>(&value8),1);
-			info.unk2 = value8 ;
-			// Quantity
-			input.read(reinterpret_cast<char*>(&value8),1);
-			info.quantity = value8;
-			// Animation
-			input.read(reinterpret_cast<char*>(&value16),2);
-			info.animid = value16 ;
-			
-			//Third a byte
-			input.read(reinterpret_cast<char*>(&value8),1);
-			info.unk3 = value8 ;
-			
-			// Hue/Value
-			input.read(reinterpret_cast<char*>(&value8),1);
-			info.hue = value8;
-			//stacking offset
-			input.read(reinterpret_cast<char*>(&value8),1);
-			info.stackingOffset = value8 ;
-			// value
-			input.read(reinterpret_cast<char*>(&value8),1);
-			info.value = value8 ;
-			// Height
-			input.read(reinterpret_cast<char*>(&value8),1);
-			info.height = value8 ;
-			// Name
-			
-			input.read(string_buffer,20);
-			string_buffer[input.gcount()]=0 ;
-			info.name = std::string(string_buffer);
-			if (input.good() && !input.eof()){
-				_art.push_back(info);
-			}
-			
-			loopcount++;
-		}while ( (!input.eof()) && (input.good()) );
-
+			tile_info info(TileType::art) ;
+			info.flag = reader.readFlag(_usedHS) ;
+			info.weight = reader.read<std::uint8_t>() ;
+			info.quality = reader.read<std::uint8_t>() ;
+			info.miscData = reader.read<std::int16_t>() ;
+			info.unk2 = reader.read<std::uint8_t>() ;
+			info.quantity = reader.read<std::uint8_t>() ;
+			info.animid = reader.read<tileid_t>() ;
+			info.unk3 = reader.read<std::uint8_t>() ;
+			info.hue = reader.read<std::uint8_t>() ;
+			info.stackingOffset = reader.read<std::uint8_t>() ;
+			info.value = reader.read<std::uint8_t>() ;
+			info.height = reader.read<std::uint8_t>() ;
+			names.push_back(reader.readName());
+			_tiles.push_back(info);
+		}
 	}
 
 	//===============================================================
@@ -383,44 +364,119 @@ namespace UO {
 		if (size == _size_for_HS){
 			_usedHS = true ;
 		}
-		std::ifstream input(path.string(),std::ios::binary);
-		if (!input.is_open()){
+		// The whole file is mapped, and parsed in one pass
+		MappedFile file(path.string()) ;
+		if (!file.isOpen()){
 			throw FileOpen(path.string());
 		}
-		// We have a good stream, time to read
-		loadTerrain(path.string(), input);
-		loadArt(path.string(),input);
+		_tiles.clear();
+		_terrain_count = 0 ;
+		_names.clear();
+		std::vector<std::uint32_t> names ;
+		tile_reader reader(file.span(), path.string(), _names) ;
+		loadTerrain(reader, names);
+		loadArt(reader, names);
+		// The names are only referred to once they are all in place
+		_names.shrink_to_fit();
+		for (std::size_t index = 0 ; index < _tiles.size(); index++){
+			_tiles[index].name = std::string_view(_names.data() + names[index]) ;
+		}
 		return true ;
 	}
 
 	//===============================================================
 	const tile_info& TileInfo::terrain(std::size_t tileid) const {
-		if (tileid >= _terrain.size()){
-			throw InvalidTileID("terrain", tileid);
-		}
-		return _terrain[tileid];
+		return _tiles[terrainHandle(tileid)];
 	}
+	
 	//===============================================================
-	tile_info& TileInfo::terrain(std::size_t tileid){
-		if (tileid >= _terrain.size()){
+	const tile_info& TileInfo::art(std::size_t tileid) const {
+		return _tiles[artHandle(tileid)];
+	}
+	//===============================================================
+	tile_handle TileInfo::terrainHandle(std::size_t tileid) const {
+		if (tileid >= sizeTerrain()){
 			throw InvalidTileID("terrain", tileid);
 		}
-		return _terrain[tileid];
+		return static_cast<tile_handle>(tileid) ;
 	}
-	
 	//===============================================================
-	const tile_info& TileInfo::art(std::size_t tileid) const {
-		if (tileid >= _art.size()){
+	tile_handle TileInfo::artHandle(std::size_t tileid) const {
+		if (tileid >= sizeArt()){
 			throw InvalidTileID("art", tileid);
 		}
-		return _art[tileid];
+		return static_cast<tile_handle>(_terrain_count + tileid) ;
 	}
 	//===============================================================
-	tile_info& TileInfo::art(std::size_t tileid){
-		if (tileid >= _art.size()){
-			throw InvalidTileID("art", tileid);
+	const tile_info& TileInfo::info(tile_handle handle) const {
+		if (handle >= _tiles.size()){
+			static const tile_info empty_info ;
+			return empty_info ;
+		}
+		return _tiles[handle] ;
+	}
+	//===============================================================
+	void TileInfo::saveTerrainColumns(const std::string &filepath) const {
+		const std::vector<column_def> columns{
+			{"tileid",ColumnType::uint16},{"flag",ColumnType::uint64},{"texture",ColumnType::uint16},
+			{"name",ColumnType::text,20}
+		};
+		ColumnWriter output(filepath, columns, sizeTerrain()) ;
+		auto tileids = output.column<tileid_t>(0) ;
+		auto flags = output.column<flag_t>(1) ;
+		auto textures = output.column<tileid_t>(2) ;
+		for (std::size_t tileid = 0 ; tileid < sizeTerrain(); tileid++){
+			const auto &info = terrain(tileid) ;
+			auto row = output.nextRow() ;
+			tileids[row] = static_cast<tileid_t>(tileid) ;
+			flags[row] = info.flag ;
+			textures[row] = info.texture ;
+			output.setText(3, row, info.name);
+		}
+		output.close();
+	}
+	//===============================================================
+	void TileInfo::saveArtColumns(const std::string &filepath) const {
+		const std::vector<column_def> columns{
+			{"tileid",ColumnType::uint16},{"flag",ColumnType::uint64},{"weight",ColumnType::uint8},
+			{"quality",ColumnType::uint8},{"miscData",ColumnType::int16},{"unk2",ColumnType::uint8},
+			{"quantity",ColumnType::uint8},{"animid",ColumnType::uint16},{"unk3",ColumnType::uint8},
+			{"hue",ColumnType::uint8},{"stackingOffset",ColumnType::uint8},{"value",ColumnType::uint8},
+			{"height",ColumnType::int16},{"name",ColumnType::text,20}
+		};
+		ColumnWriter output(filepath, columns, sizeArt()) ;
+		auto tileids = output.column<tileid_t>(0) ;
+		auto flags = output.column<flag_t>(1) ;
+		auto weights = output.column<std::uint8_t>(2) ;
+		auto qualities = output.column<std::uint8_t>(3) ;
+		auto miscdata = output.column<std::int16_t>(4) ;
+		auto unk2s = output.column<std::uint8_t>(5) ;
+		auto quantities = output.column<std::uint8_t>(6) ;
+		auto animids = output.column<tileid_t>(7) ;
+		auto unk3s = output.column<std::uint8_t>(8) ;
+		auto hues = output.column<std::uint8_t>(9) ;
+		auto offsets = output.column<std::uint8_t>(10) ;
+		auto values = output.column<std::uint8_t>(11) ;
+		auto heights = output.column<std::int16_t>(12) ;
+		for (std::size_t tileid = 0 ; tileid < sizeArt(); tileid++){
+			const auto &info = art(tileid) ;
+			auto row = output.nextRow() ;
+			tileids[row] = static_cast<tileid_t>(tileid) ;
+			flags[row] = info.flag ;
+			weights[row] = info.weight ;
+			qualities[row] = info.quality ;
+			miscdata[row] = info.miscData ;
+			unk2s[row] = info.unk2 ;
+			quantities[row] = info.quantity ;
+			animids[row] = info.animid ;
+			unk3s[row] = info.unk3 ;
+			hues[row] = info.hue ;
+			offsets[row] = info.stackingOffset ;
+			values[row] = info.value ;
+			heights[row] = info.height ;
+			output.setText(13, row, info.name);
 		}
-		return _art[tileid];
+		output.close();
 	}
 
 }
@@ -4,17 +4,22 @@
 #define TileInfo_hpp
 
 #include <string>
+#include <string_view>
 #include <cstdint>
 #include <vector>
 #include <array>
 namespace UO {
+	class TileInfo ;
 	//===============================================================
 	using flag_t = std::uint64_t ;
 	using tileid_t = std::uint16_t ;
+	// An entry of the tile data (terrain and art together), see TileInfo::info()
+	using tile_handle = std::uint32_t ;
 
 
 	//===============================================================
 	static constexpr tileid_t invalid_tileid = 0xFFFF ;
+	static constexpr tile_handle invalid_handle = 0xFFFFFFFF ;
 	
 	//===============================================================
 	//flag constants
@@ -97,10 +102,12 @@ namespace UO {
 	
 	//=======================================================================
 	// Define the basic tile structures
-	enum class TileType { invalid,terrain,art};
+	enum class TileType : std::uint8_t { invalid,terrain,art};
 	
 	
 	//===============================================================
+	// A plain (trivially copyable) record, the name refers to the names held by
+	// the TileInfo it came from.  The fields are ordered to pack them.
 	struct tile_info {
 	private:
 		static const std::array<std::string,64> _flag_names ;
@@ -111,57 +118,66 @@ namespace UO {
 		std::string rowTerrain()const ;
 		std::string rowArt() const ;
 	public:
-		TileType type ;
 		// Common attributes
-		std::string name ;
 		std::uint64_t flag ;
+		std::string_view name ;
 		// Terrain only
 		tileid_t texture ;
 		// Art only
+		tileid_t	 animid ;
+		std::int16_t miscData ; // std::uint16_t in data
+		std::int16_t height ; // This is a uint8_t in the data,
+		TileType type ;
 		std::uint8_t weight ;  // std::uint8_t in data
 		std::uint8_t quality ; // std::uint8_t in data
-		std::int16_t miscData ; // std::uint16_t in data
 		std::uint8_t unk2 ;	// std::uint8_t in data
 		std::uint8_t quantity ;	// std::uint8_t in data
-		tileid_t	 animid ;
 		std::uint8_t unk3 ;	// std::uint8_t in data
 		std::uint8_t hue ;	// std::uint8_t in data
 		std::uint8_t stackingOffset ;  // unk4
 		std::uint8_t value ; // unk5 , std::uint8_t in data
-		std::int16_t height ; // This is a uint8_t in the data,
 
 		//Methods
 		std::string description() const;
 		
 		static std::string descFlag(std::uint64_t flag)  ;
-		virtual std::string csvRow() const ;
-		virtual std::string csvTitle()const ;
+		std::string csvRow() const ;
+		std::string csvTitle()const ;
 		tile_info(TileType type=TileType::invalid);
 	};
 	
 	//===============================================================
+	// The tile information is referred to by handle into tiledata (the tile data of
+	// the map it came from, which the tile keeps), not copied
 	struct tile_st {
 		tileid_t tileid ;
-		tile_info info ;
+		tile_handle handle ;
 		std::int32_t z ;
 		bool isStatic;
 		std::uint16_t artHue ;
 		tile_st() ;
-		tile_st(tileid_t tileid);
+		tile_st(tileid_t tileid, tile_handle handle = invalid_handle);
+		// The handle is resolved with tiledata, which has to be the tile data of the
+		// map that made the tile (see its tileData())
+		const tile_info & info(const TileInfo &tiledata) const ;
 		bool lowerAltitude( const tile_st &rhs) const ;
-		bool operator<(const tile_st &rhs) const ;
+		// Compares altitude+height
+		bool lowerTop(const tile_st &rhs, const TileInfo &tiledata) const ;
 	};
 
 	//===============================================================
 	struct multi_st {
 		tileid_t tileid ;
-		tile_info info ;
+		tile_handle handle ;
 		std::int32_t x ;
 		std::int32_t y;
 		std::int32_t z ;
 		std::uint64_t flag ;
 		multi_st();
 		multi_st(tileid_t tileid) ;
+		// The handle is resolved with tiledata, the tile data of the MultiData it
+		// came from (see its tileData())
+		const tile_info & info(const TileInfo &tiledata) const ;
 	};
 	//===============================================================
 	struct multi_structure {
@@ -187,27 +203,42 @@ namespace UO {
 		
 		static const std::string _tiledata_mul ;
 		static constexpr auto _size_for_HS = 3188736;
-		std::vector<tile_info> _terrain ;
-		std::vector<tile_info> _art ;
+		// The terrain entries, then the art entries (a handle is the index)
+		std::vector<tile_info> _tiles ;
+		std::size_t _terrain_count ;
+		// Every distinct name once, the entries' names refer to it
+		std::string _names ;
 		
-		
-		void loadTerrain(const std::string &pathname, std::ifstream &input);
-		void loadArt(const std::string &pathname, std::ifstream &input);
+		struct tile_reader ;
+		void loadTerrain(tile_reader &reader, std::vector<std::uint32_t> &names);
+		void loadArt(tile_reader &reader, std::vector<std::uint32_t> &names);
 	protected:
 		bool _usedHS ;
 
 	public:
+		TileInfo() ;
+		// The names of the entries refer to this TileInfo, so it is not copied
+		TileInfo(const TileInfo&) = delete ;
+		TileInfo & operator=(const TileInfo&) = delete ;
 		
-		std::size_t sizeTerrain() const {return _terrain.size();}
-		std::size_t sizeArt() const {return _art.size();}
+		std::size_t sizeTerrain() const {return _terrain_count;}
+		std::size_t sizeArt() const {return _tiles.size() - _terrain_count;}
 		
+		// Only const, the names refer to the TileInfo and can not be assigned
 		const tile_info& terrain(std::size_t tileid) const ;
-		tile_info& terrain(std::size_t tileid);
-		
 		const tile_info& art(std::size_t tileid) const ;
-		tile_info& art(std::size_t tileid);
+
+		// Throw InvalidTileID (as terrain()/art()) if there is no such tile
+		tile_handle terrainHandle(std::size_t tileid) const ;
+		tile_handle artHandle(std::size_t tileid) const ;
+		// An empty (invalid) tile_info for invalid_handle
+		const tile_info& info(tile_handle handle) const ;
 
 		bool load(const std::string &uodir_tiledata);
+		// Column files of the tile information (a row per tileid), the dimension
+		// tables for the map column files
+		void saveTerrainColumns(const std::string &filepath) const ;
+		void saveArtColumns(const std::string &filepath) const ;
 	};
 }
 
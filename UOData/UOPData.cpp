@@ -3,9 +3,19 @@
 #include "UOPData.hpp"
 #include "StringUtility.hpp"
 #include "UOAlerts.hpp"
+#include "RecordIndex.hpp"
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <fstream>
 #include <limits>
+#include <mutex>
+#include <thread>
 namespace UO {
 	
 	/*************************************************************************
@@ -52,9 +62,9 @@ namespace UO {
 	 zlib wrappers for compression
 	 ***********************************************************************/
 	//=============================================================================
-	std::vector<uint8_t> UOPData::decompress(const std::vector<uint8_t> &source, std::size_t decompressed_size) const{
+	std::vector<uint8_t> UOPData::decompress(const ByteSpan &source, std::size_t decompressed_size) const{
 		// uLongf is from zlib.h
-		auto srcsize = static_cast<uLongf>(source.size()) ;
+		auto srcsize = static_cast<uLong>(source.size()) ;
 		auto destsize = static_cast<uLongf>(decompressed_size);
 		std::vector<uint8_t> dest(decompressed_size,0);
 		auto status = uncompress2(dest.data(), &destsize, source.data(), &srcsize);
@@ -86,8 +96,12 @@ namespace UO {
 	
 	//=============================================================================
 	std::uint64_t UOPData::hashLittle2(const std::string& s)  {
+		return hashLittle2(s.data(), s.size());
+	}
+	//=============================================================================
+	std::uint64_t UOPData::hashLittle2(const char *s, std::size_t size)  {
 		
-		std::uint32_t length = static_cast<std::uint32_t>(s.size()) ;
+		std::uint32_t length = static_cast<std::uint32_t>(size) ;
 		std::uint32_t a ;
 		std::uint32_t b ;
 		std::uint32_t c ;
@@ -199,11 +213,12 @@ namespace UO {
 	}
 	
 	//===============================================================
-	std::size_t UOPData::findIndex(const std::vector<std::uint64_t> &hashdata, std::uint64_t hash){
-		auto iter = std::find(hashdata.cbegin(),hashdata.cend(),hash);
-		if (iter != hashdata.cend()){
-			return std::distance(hashdata.cbegin(), iter);
-
+	std::size_t UOPData::findIndex(const hash_table &hashdata, std::uint64_t hash) const{
+		auto iter = std::lower_bound(hashdata.cbegin(),hashdata.cend(),hash,[](const std::pair<std::uint64_t,std::size_t> &entry, std::uint64_t value){
+			return entry.first < value ;
+		});
+		if ((iter != hashdata.cend()) && (iter->first == hash)){
+			return iter->second;
 		}
 		return std::numeric_limits<std::size_t>::max();
 	}
@@ -229,22 +244,58 @@ namespace UO {
 			return std::vector<std::uint64_t>();
 		}
 		hashstorage.reserve(max_index+1);
-		for (auto i=0 ; i<= max_index;i++){
-			hashstorage.push_back(hashLittleFor(hashformat, i));
+		auto pos = hashformat.find_first_of("{") ;
+		auto loc = (pos == std::string::npos) ? std::string::npos : hashformat.find_first_of("}",pos+1) ;
+		// The name is built in place: the prefix is copied once, and for each
+		// index only the number and the suffix are written behind it.
+		std::array<char,256> name ;
+		constexpr std::size_t max_digits = 20 ;
+		if ((loc == std::string::npos) || (hashformat.size() + max_digits > name.size())){
+			// Nothing to subsitute (or a format we don't expect), let format handle it
+			for (std::size_t i=0 ; i<= max_index;i++){
+				hashstorage.push_back(hashLittleFor(hashformat, i));
+			}
+			return hashstorage;
+		}
+		auto width = static_cast<std::size_t>(std::max(strutil::strtoi(hashformat.substr(pos+1,loc-(pos+1))),0));
+		width = std::min(width, max_digits);
+		auto suffix = hashformat.substr(loc+1);
+		std::copy(hashformat.begin(),hashformat.begin()+pos,name.begin());
+		auto number = name.data() + pos ;
+		std::array<char,max_digits> digits ;
+		for (std::size_t i=0 ; i<= max_index;i++){
+			auto [end,ec] = std::to_chars(digits.data(), digits.data()+digits.size(), i);
+			auto count = static_cast<std::size_t>(end - digits.data()) ;
+			auto pad = (count < width) ? (width - count) : 0 ;
+			std::memset(number, '0', pad);
+			std::memcpy(number+pad, digits.data(), count);
+			std::memcpy(number+pad+count, suffix.data(), suffix.size());
+			hashstorage.push_back(hashLittle2(name.data(), pos + pad + count + suffix.size()));
 		}
 		return hashstorage;
 	}
+	//===============================================================
+	// Builds one lookup table for both formats.  The sort is stable, so if a hash
+	// appears more than once, the first format (and lowest index) is found first,
+	// as it was with the sequential search.
+	UOPData::hash_table UOPData::buildHashTable(std::size_t max_index, const std::string &hashformat1, const std::string &hashformat2){
+		hash_table table ;
+		for (const auto &hashformat : {hashformat1,hashformat2}){
+			auto hashstorage = buildIndexHashes(hashformat, max_index);
+			table.reserve(table.size() + hashstorage.size());
+			for (std::size_t index = 0 ; index < hashstorage.size(); index++){
+				table.push_back(std::make_pair(hashstorage[index], index));
+			}
+		}
+		std::stable_sort(table.begin(),table.end(),[](const std::pair<std::uint64_t,std::size_t> &lhs, const std::pair<std::uint64_t,std::size_t> &rhs){
+			return lhs.first < rhs.first ;
+		});
+		return table ;
+	}
 
 	
-	/************************************************************************
-	 Public  routines
-	 ***********************************************************************/
 	//===============================================================
-	void UOPData::loadUOP(const std::string &filepath, std::size_t max_hashindex , const std::string &hashformat1, const std::string &hashformat2 ){
-		std::ifstream input(filepath, std::ios::binary);
-		if (!input.is_open()){
-			throw FileOpen(filepath);
-		}
+	std::vector<UOPData::table_entry> UOPData::readTable(std::istream &input, const std::string &filepath){
 		// Make sure this is a format and version we understand
 		std::uint32_t sig  = 0 ;
 		std::uint32_t version = 0 ;
@@ -254,9 +305,6 @@ namespace UO {
 		if ((version > _uop_version) || (sig != _uop_identifer)){
 			throw InvalidUOP(sig, version,filepath);
 		}
-		auto hashstorage1 = buildIndexHashes(hashformat1,max_hashindex);
-		auto hashstorage2 = buildIndexHashes(hashformat2, max_hashindex);
-		
 		std::uint64_t table_offset = 0;
 		std::uint32_t tablesize = 0 ;
 		std::uint32_t maxentry = 0 ;
@@ -280,41 +328,210 @@ namespace UO {
 				input.seekg(table_offset,std::ios::beg);
 			}
 		}
-		auto current_entry = 0 ;
-		for (auto &entry : entries){
-			// Now loop through entries
+		return entries ;
+	}
+
+	/************************************************************************
+	 Public  routines
+	 ***********************************************************************/
+	//===============================================================
+	void UOPData::loadUOP(const std::string &filepath, std::size_t max_hashindex , const std::string &hashformat1, const std::string &hashformat2 ){
+		std::ifstream input(filepath, std::ios::binary);
+		if (!input.is_open()){
+			throw FileOpen(filepath);
+		}
+		auto hashtable = buildHashTable(max_hashindex, hashformat1, hashformat2);
+		auto entries = readTable(input, filepath);
+		input.close();
+		MappedFile uop(filepath);
+		if (!uop.isOpen()){
+			throw FileOpen(filepath);
+		}
+		// Find the entries we care about, and where their data is
+		std::vector<std::size_t> wanted ;
+		std::vector<ByteSpan> source(entries.size()) ;
+		std::size_t compressed = 0 ;
+		for (std::size_t current_entry = 0 ; current_entry < entries.size() ; current_entry++){
+			const auto &entry = entries[current_entry] ;
 			if ((entry.identifer != 0 ) && (entry.compressed_length != 0)) {
-				input.seekg(entry.offset+entry.header_length,std::ios::beg) ;
 				auto size = (entry.compression==0)?entry.decompressed_length : entry.compressed_length ;
-				std::vector<std::uint8_t> uopdata(size,0);
-				input.read(reinterpret_cast<char*>(uopdata.data()),size);
+				source[current_entry] = uop.span(entry.offset+entry.header_length, size);
+				if (source[current_entry].size() != size){
+					throw StreamError(filepath);
+				}
+				wanted.push_back(current_entry);
 				if (entry.compression == 1){
-					uopdata = decompress(uopdata, entry.decompressed_length);
+					compressed++ ;
 				}
-				// First see if we should even do anything with this hash
-				if (processHash(entry.identifer, current_entry, uopdata)) {
-					// Yes, we should!
-					// Can we find an index?
-					
-					
-					auto 	index = findIndex(hashstorage1, entry.identifer);
-					if (index == std::numeric_limits<std::size_t>::max()){
-						
-						index = findIndex(hashstorage2, entry.identifer);
+			}
+		}
+		auto threadcount = std::min<std::size_t>(std::max(1u,std::thread::hardware_concurrency()), compressed) ;
+		if (threadcount < 2){
+			// Not worth the threads
+			for (auto current_entry : wanted){
+				const auto &entry = entries[current_entry] ;
+				auto uopdata = (entry.compression == 1) ? decompress(source[current_entry], entry.decompressed_length) : source[current_entry].copy() ;
+				deliverEntry(entry, current_entry, uopdata, hashtable, filepath);
+			}
+			endUOPProcessing();
+			return ;
+		}
+		
+		// The workers take the next entry, and put the data into its (presized) buffer.
+		// A worker does not start an entry more than window entries past those
+		// delivered, so only that many decompressed entries are held at once.
+		std::vector<std::vector<std::uint8_t>> uopdata(entries.size());
+		std::vector<bool> ready(entries.size(),false);
+		std::deque<std::size_t> completed ;
+		std::atomic<std::size_t> next(0) ;
+		std::mutex lock ;
+		std::condition_variable signal ;	// an entry is ready (or a worker failed)
+		std::condition_variable space ;		// an entry was delivered (or stop)
+		std::size_t delivered = 0 ;
+		const auto window = threadcount * 4 ;
+		bool stop = false ;
+		std::exception_ptr error ;
+		auto inorder = !entryOrderIndependent() ;
+		auto worker = [&](){
+			try {
+				for (auto position = next++ ; position < wanted.size() ; position = next++){
+					{
+						std::unique_lock<std::mutex> guard(lock);
+						space.wait(guard, [&](){ return stop || (position < delivered + window);});
+						if (stop){
+							return ;
+						}
 					}
-					if (index == std::numeric_limits<std::size_t>::max()){
-						
-						if (!nonIndexHash(entry.identifer, current_entry, uopdata)){
-							throw UnknownHash(entry.identifer,filepath);
+					auto current_entry = wanted[position] ;
+					const auto &entry = entries[current_entry] ;
+					auto data = (entry.compression == 1) ? decompress(source[current_entry], entry.decompressed_length) : source[current_entry].copy() ;
+					{
+						std::lock_guard<std::mutex> guard(lock);
+						uopdata[current_entry] = std::move(data);
+						ready[current_entry] = true ;
+						if (!inorder){
+							completed.push_back(current_entry);
 						}
 					}
-					
-					processEntry(current_entry, index, uopdata);
+					signal.notify_one();
+				}
+			}
+			catch(...){
+				// The first failure is rethrown on the calling thread, and the rest stop
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					if (!error){
+						error = std::current_exception();
+					}
+					stop = true ;
+				}
+				next = wanted.size() ;
+				signal.notify_all();
+				space.notify_all();
+			}
+		};
+		std::vector<std::thread> threads ;
+		auto finish = [&](){
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stop = true ;
+			}
+			next = wanted.size() ;
+			space.notify_all();
+			for (auto &thread : threads){
+				thread.join();
+			}
+		};
+		for (std::size_t i = 0 ; i < threadcount ; i++){
+			threads.push_back(std::thread(worker));
+		}
+		try {
+			for (std::size_t position = 0 ; position < wanted.size() ; position++){
+				std::vector<std::uint8_t> data ;
+				std::size_t current_entry = 0 ;
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					if (inorder) {
+						current_entry = wanted[position] ;
+						signal.wait(guard, [&](){ return (error != nullptr) || ready[current_entry];});
+					}
+					else {
+						signal.wait(guard, [&](){ return (error != nullptr) || !completed.empty();});
+					}
+					if (error != nullptr){
+						break ;
+					}
+					if (!inorder){
+						current_entry = completed.front() ;
+						completed.pop_front();
+					}
+					data = std::move(uopdata[current_entry]);
+					delivered++ ;
+				}
+				space.notify_all();
+				deliverEntry(entries[current_entry], current_entry, data, hashtable, filepath);
+			}
+		}
+		catch(...){
+			finish();
+			throw ;
+		}
+		finish();
+		if (error != nullptr){
+			std::rethrow_exception(error);
+		}
+		endUOPProcessing();
+	}
+	//===============================================================
+	void UOPData::deliverEntry(const table_entry &entry, std::size_t current_entry, const std::vector<std::uint8_t> &data, const hash_table &hashtable, const std::string &filepath){
+		// First see if we should even do anything with this hash
+		if (processHash(entry.identifer, current_entry, data)) {
+			// Yes, we should!
+			// Can we find an index?
+			auto 	index = findIndex(hashtable, entry.identifer);
+			if (index == std::numeric_limits<std::size_t>::max()){
+				
+				if (!nonIndexHash(entry.identifer, current_entry, data)){
+					throw UnknownHash(entry.identifer,filepath);
+				}
+			}
+			
+			processEntry(current_entry, index, data);
+		}
+	}
+	//===============================================================
+	void UOPData::indexUOP(const std::string &filepath, std::size_t max_hashindex , RecordIndex &index, const std::string &hashformat1, const std::string &hashformat2 ){
+		index.clear();
+		std::ifstream input(filepath, std::ios::binary);
+		if (!input.is_open()){
+			throw FileOpen(filepath);
+		}
+		auto hashtable = buildHashTable(max_hashindex, hashformat1, hashformat2);
+		auto entries = readTable(input, filepath);
+		input.close();
+		if (!index.open(filepath)){
+			throw FileOpen(filepath);
+		}
+		auto current_entry = 0 ;
+		for (auto &entry : entries){
+			if ((entry.identifer != 0 ) && (entry.compressed_length != 0)) {
+				auto 	id = findIndex(hashtable, entry.identifer);
+				if (id == std::numeric_limits<std::size_t>::max()){
+					if (!nonIndexHash(entry.identifer, current_entry, std::vector<std::uint8_t>())){
+						throw UnknownHash(entry.identifer,filepath);
+					}
+				}
+				else {
+					record_entry value ;
+					value.offset = static_cast<std::uint64_t>(entry.offset) + entry.header_length ;
+					value.length = (entry.compression==0)?entry.decompressed_length : entry.compressed_length ;
+					value.decompressed_length = entry.decompressed_length ;
+					value.compression = entry.compression ;
+					index.set(id, value);
 				}
 			}
 			current_entry++ ;
 		}
 		endUOPProcessing();
 	}
-
 }
@@ -126,10 +126,13 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include <utility>
 #include <zlib.h>
+#include "MappedFile.hpp"
 
 using namespace std::string_literals;
 namespace UO {
+	class RecordIndex ;
 	class UOPData {
 	private:
 		
@@ -157,20 +160,26 @@ namespace UO {
 		
 		std::vector<std::uint64_t> _hash1 ;
 		std::vector<std::uint64_t> _hash2 ;
+		// hash/index pairs, sorted by hash so an index can be found with a binary search
+		using hash_table = std::vector<std::pair<std::uint64_t,std::size_t>> ;
 		/************************************************************************
 		 Hash routines
 		 ***********************************************************************/
 		static std::uint64_t hashLittle2(const std::string& s) ;
+		static std::uint64_t hashLittle2(const char *s, std::size_t size) ;
 		static std::uint32_t hashAdler32(const std::vector<std::uint8_t> &data) ;
 		std::string format(const std::string& hashformat, std::size_t index) const;
-		std::size_t findIndex(const std::vector<std::uint64_t> &hashdata, std::uint64_t hash);
+		std::size_t findIndex(const hash_table &hashdata, std::uint64_t hash) const;
 		
 		/****************** zlib compression wrappers *********************/
 		std::vector<unsigned char> compress(const std::vector<std::uint8_t> &data) const;
-		std::vector<unsigned char> decompress(const std::vector<std::uint8_t> &source, std::size_t decompressed_size) const;
+		std::vector<unsigned char> decompress(const ByteSpan &source, std::size_t decompressed_size) const;
 
 		
 		std::vector<std::uint64_t> buildIndexHashes(const std::string &hashformat, std::size_t max_index) ;
+		hash_table buildHashTable(std::size_t max_index, const std::string &hashformat1, const std::string &hashformat2) ;
+		std::vector<table_entry> readTable(std::istream &input, const std::string &filepath) ;
+		void deliverEntry(const table_entry &entry, std::size_t current_entry, const std::vector<std::uint8_t> &data, const hash_table &hashtable, const std::string &filepath);
 		std::uint64_t hashLittleFor(const std::string &hashstring, std::size_t index) const;
 
 	protected:
@@ -179,8 +188,14 @@ namespace UO {
 		virtual bool processHash(std::uint64_t hash,std::size_t entry , const std::vector<std::uint8_t> &data){return true;}
 		virtual bool nonIndexHash(std::uint64_t hash, std::size_t entry, const std::vector<std::uint8_t> &data);
 		virtual void endUOPProcessing() {};
+		// Compressed entries are decompressed on several threads.  The entries are
+		// given to processHash/processEntry (always on the calling thread) in table
+		// order, unless this returns true, in which case they are given as they are ready.
+		virtual bool entryOrderIndependent() const { return false;}
 		
 		void loadUOP(const std::string &filepath, std::size_t max_hashindex , const std::string &hashformat1, const std::string &hashformat2 = "");
+		// Only index the file, the data is fetched (and decompressed) from the index when needed
+		void indexUOP(const std::string &filepath, std::size_t max_hashindex , RecordIndex &index, const std::string &hashformat1, const std::string &hashformat2 = "");
 
 	public:
 		virtual ~UOPData() = default;
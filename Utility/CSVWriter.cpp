@@ -0,0 +1,128 @@
+//Copyright © 2021 Charles Kerr. All rights reserved.
+
+#include "CSVWriter.hpp"
+#include "WorkQueue.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+/*******************************************************************************
+ CSVBuffer
+ *******************************************************************************/
+//===============================================================
+CSVBuffer::CSVBuffer(std::size_t capacity){
+	_size = 0 ;
+	_data.resize(std::max<std::size_t>(capacity, 1024));
+}
+//===============================================================
+char * CSVBuffer::reserve(std::size_t amount) {
+	if ((_size + amount) > _data.size()){
+		_data.resize(std::max(_data.size() * 2, _size + amount));
+	}
+	return _data.data() + _size ;
+}
+//===============================================================
+CSVBuffer & CSVBuffer::text(std::string_view value) {
+	auto ptr = reserve(value.size());
+	std::memcpy(ptr, value.data(), value.size());
+	_size += value.size() ;
+	return *this ;
+}
+//===============================================================
+CSVBuffer & CSVBuffer::comma() {
+	*reserve(1) = ',' ;
+	_size++ ;
+	return *this ;
+}
+//===============================================================
+CSVBuffer & CSVBuffer::endRow() {
+	*reserve(1) = '\n' ;
+	_size++ ;
+	return *this ;
+}
+//===============================================================
+CSVBuffer & CSVBuffer::hex(std::uint64_t value, int digits) {
+	std::array<char,16> str ;
+	auto [end,ec] = std::to_chars(str.data(), str.data() + str.size(), value, 16);
+	auto length = static_cast<std::size_t>(end - str.data()) ;
+	auto padding = (length < static_cast<std::size_t>(digits)) ? (digits - length) : 0 ;
+	auto ptr = reserve(2 + padding + length) ;
+	*(ptr++) = '0' ;
+	*(ptr++) = 'x' ;
+	ptr = std::fill_n(ptr, padding, '0');
+	std::memcpy(ptr, str.data(), length);
+	_size += 2 + padding + length ;
+	return *this ;
+}
+
+/*******************************************************************************
+ CSVWriter
+ *******************************************************************************/
+//===============================================================
+CSVWriter::CSVWriter(const std::string &filepath, WorkQueue *queue, std::size_t flush_size) : _buffer(flush_size + (flush_size/4)) {
+	_flush_size = flush_size ;
+	if (!_output.open(filepath, queue)){
+		throw std::runtime_error("Unable to create: "s + filepath);
+	}
+}
+//===============================================================
+CSVWriter::~CSVWriter() {
+	close();
+}
+//===============================================================
+void CSVWriter::flush(bool force) {
+	if ((_buffer.size() >= _flush_size) || (force && !_buffer.empty())){
+		write(_buffer);
+		_buffer.clear();
+	}
+}
+//===============================================================
+void CSVWriter::write(const CSVBuffer &buffer) {
+	_output.write(buffer.data(), buffer.size());
+}
+//===============================================================
+void CSVWriter::close() {
+	if (_output.is_open()){
+		flush(true);
+		_output.close();
+	}
+}
+//===============================================================
+void CSVWriter::writeRows(std::size_t count, const row_format &format, WorkQueue *queue, std::size_t chunk) {
+	flush(true);
+	chunk = std::max<std::size_t>(chunk, 1);
+	auto formatChunk = [&format,count,chunk](std::size_t first, CSVBuffer &buffer){
+		buffer.clear();
+		for (auto row = first ; row < std::min(first + chunk, count) ; row++){
+			format(row, buffer);
+		}
+	};
+	if ((queue == nullptr) || (queue->threads() < 2)){
+		for (std::size_t first = 0 ; first < count ; first += chunk){
+			formatChunk(first, _buffer);
+			flush(true);
+		}
+		return ;
+	}
+	// A window of chunks is formatted at once, then written in order
+	std::vector<CSVBuffer> buffers(queue->threads() * 2) ;
+	for (std::size_t start = 0 ; start < count ; start += buffers.size() * chunk){
+		for (std::size_t index = 0 ; index < buffers.size() ; index++){
+			auto first = start + (index * chunk) ;
+			if (first >= count){
+				buffers[index].clear();
+				continue ;
+			}
+			queue->add([&formatChunk,&buffers,index,first](){
+				formatChunk(first, buffers[index]);
+			});
+		}
+		queue->wait();
+		for (const auto &buffer : buffers){
+			write(buffer);
+		}
+	}
+}
@@ -0,0 +1,93 @@
+//Copyright © 2021 Charles Kerr. All rights reserved.
+
+#ifndef CSVWriter_hpp
+#define CSVWriter_hpp
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <charconv>
+#include <type_traits>
+#include <functional>
+
+#include "OutputFile.hpp"
+
+class WorkQueue ;
+
+/******************************************************************************
+ CSVBuffer
+ 	Formats csv rows into a block of memory.  Numbers are formatted with
+ to_chars straight into the buffer, so a row does not make any strings.
+ ******************************************************************************/
+//===============================================================
+class CSVBuffer {
+private:
+	std::vector<char> _data ;
+	std::size_t _size ;
+
+	// Makes sure there is room for amount more characters, and returns where they go
+	char * reserve(std::size_t amount) ;
+public:
+	CSVBuffer(std::size_t capacity = 0) ;
+
+	const char * data() const { return _data.data();}
+	std::size_t size() const { return _size;}
+	bool empty() const { return _size == 0 ;}
+	void clear() { _size = 0 ;}
+
+	CSVBuffer & text(std::string_view value) ;
+	CSVBuffer & comma() ;
+	CSVBuffer & endRow() ;
+	// 0x and at least digits hex digits (lower case), as strutil::numtostr(value,16,true,digits)
+	CSVBuffer & hex(std::uint64_t value, int digits = 4) ;
+
+	template <typename T>
+	typename std::enable_if<std::is_integral_v<T> && !std::is_same_v<T,bool>,CSVBuffer&>::type
+	number(T value){
+		// Enough for any 64 bit value, and a sign
+		constexpr std::size_t max_digits = 21 ;
+		auto ptr = reserve(max_digits) ;
+		auto [end,ec] = std::to_chars(ptr, ptr + max_digits, value);
+		_size += static_cast<std::size_t>(end - ptr) ;
+		return *this ;
+	}
+};
+
+/******************************************************************************
+ CSVWriter
+ 	Writes csv rows to a file in large blocks.  Rows are formatted into buffer()
+ and flush() writes the buffer out once it is big enough.  writeRows() formats
+ ranges of rows on the threads of a WorkQueue and writes them in order.  The
+ file is gzipped if its name ends in ".gz" (see OutputFile), with the blocks
+ deflated on the queue given here.
+ ******************************************************************************/
+//===============================================================
+class CSVWriter {
+private:
+	OutputFile _output ;
+	CSVBuffer _buffer ;
+	std::size_t _flush_size ;
+
+public:
+	// Throws std::runtime_error if the file can not be created
+	CSVWriter(const std::string &filepath, WorkQueue *queue = nullptr, std::size_t flush_size = 4*1024*1024) ;
+	CSVWriter(const CSVWriter&) = delete ;
+	CSVWriter & operator=(const CSVWriter&) = delete ;
+	~CSVWriter() ;
+
+	CSVBuffer & buffer() { return _buffer;}
+	// Writes the buffer if it has reached the flush size (or always, if force)
+	void flush(bool force = false) ;
+	void write(const CSVBuffer &buffer) ;
+	void close() ;
+
+	// Formats rows [0,count), chunk rows at a time, with format(row, buffer).  With a
+	// queue the chunks are formatted on its threads (so this should not be called
+	// from a task on that queue).  The chunks are written in order.
+	using row_format = std::function<void(std::size_t row, CSVBuffer &buffer)> ;
+	void writeRows(std::size_t count, const row_format &format, WorkQueue *queue = nullptr, std::size_t chunk = 16) ;
+};
+
+#endif /* CSVWriter_hpp */
@@ -0,0 +1,209 @@
+//Copyright © 2021 Charles Kerr. All rights reserved.
+
+#include "ColumnFile.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+//===============================================================
+static constexpr std::array<char,8> column_magic{'U','O','C','O','L','S','0','1'} ;
+static constexpr std::size_t header_size = 24 ;
+static constexpr std::size_t column_entry_size = 40 ;
+static constexpr std::size_t column_name_size = 32 ;
+
+//===============================================================
+static std::size_t padded(std::size_t size) {
+	return (size + 7) & ~static_cast<std::size_t>(7) ;
+}
+//===============================================================
+// The size of a chunk of rows rows, and where each column is in it
+static std::size_t chunkLayout(const std::vector<column_def> &columns, std::size_t rows, std::vector<std::size_t> *offsets = nullptr) {
+	std::size_t size = 0 ;
+	if (offsets != nullptr){
+		offsets->clear();
+	}
+	for (const auto &column : columns){
+		if (offsets != nullptr){
+			offsets->push_back(size);
+		}
+		size += padded(rows * column.width) ;
+	}
+	return size ;
+}
+
+/*******************************************************************************
+ column_def
+ *******************************************************************************/
+//===============================================================
+column_def::column_def(const std::string &name, ColumnType type, std::uint32_t width) : name(name), type(type) {
+	this->width = (type == ColumnType::text) ? width : typeWidth(type) ;
+}
+//===============================================================
+std::uint32_t column_def::typeWidth(ColumnType type) {
+	switch (type) {
+		case ColumnType::uint8:
+		case ColumnType::int8:
+			return 1 ;
+		case ColumnType::uint16:
+		case ColumnType::int16:
+			return 2 ;
+		case ColumnType::uint32:
+		case ColumnType::int32:
+			return 4 ;
+		case ColumnType::uint64:
+		case ColumnType::int64:
+			return 8 ;
+		default:
+			return 0 ;
+	}
+}
+
+/*******************************************************************************
+ ColumnWriter
+ *******************************************************************************/
+//===============================================================
+ColumnWriter::ColumnWriter(const std::string &filepath, const std::vector<column_def> &columns, std::uint64_t rows, std::uint32_t chunk_rows) : _columns(columns) {
+	_rows = rows ;
+	_written = 0 ;
+	_chunk_rows = std::max<std::uint32_t>(chunk_rows, 1) ;
+	_filled = 0 ;
+	_chunk.resize(chunkLayout(_columns, _chunk_rows, &_offsets), 0);
+	_output.open(filepath, std::ios::binary);
+	if (!_output.is_open()){
+		throw std::runtime_error("Unable to create: "s + filepath);
+	}
+	std::vector<std::uint8_t> header(padded(header_size + (_columns.size() * column_entry_size)), 0) ;
+	auto count = static_cast<std::uint32_t>(_columns.size()) ;
+	std::copy(column_magic.begin(), column_magic.end(), header.begin());
+	std::memcpy(header.data() + 8, &_rows, 8);
+	std::memcpy(header.data() + 16, &_chunk_rows, 4);
+	std::memcpy(header.data() + 20, &count, 4);
+	auto entry = header.data() + header_size ;
+	for (const auto &column : _columns){
+		std::memcpy(entry, column.name.c_str(), std::min(column.name.size(), column_name_size - 1));
+		entry[column_name_size] = static_cast<std::uint8_t>(column.type) ;
+		std::memcpy(entry + column_name_size + 4, &column.width, 4);
+		entry += column_entry_size ;
+	}
+	_output.write(reinterpret_cast<const char*>(header.data()), header.size());
+}
+//===============================================================
+ColumnWriter::~ColumnWriter() {
+	if (_output.is_open()){
+		// Can not throw from here, so what was added is written as is
+		writeChunk();
+		_output.close();
+	}
+}
+//===============================================================
+void ColumnWriter::writeChunk() {
+	if (_filled == 0){
+		return ;
+	}
+	for (std::size_t index = 0 ; index < _columns.size(); index++){
+		auto size = _filled * _columns[index].width ;
+		auto ptr = _chunk.data() + _offsets[index] ;
+		// The padding is taken from the storage, which is zeroed (if past the rows)
+		std::fill(ptr + size, ptr + padded(size), 0);
+		_output.write(reinterpret_cast<const char*>(ptr), padded(size));
+	}
+	_written += _filled ;
+	_filled = 0 ;
+}
+//===============================================================
+std::size_t ColumnWriter::nextRow() {
+	if ((_written + _filled) >= _rows){
+		throw std::runtime_error("More rows than the column file was created for"s);
+	}
+	if (_filled == _chunk_rows){
+		writeChunk();
+	}
+	return _filled++ ;
+}
+//===============================================================
+void ColumnWriter::setText(std::size_t index, std::size_t row, std::string_view value) {
+	auto width = static_cast<std::size_t>(_columns.at(index).width) ;
+	auto ptr = reinterpret_cast<char*>(_chunk.data() + _offsets[index]) + (row * width) ;
+	auto length = std::min(value.size(), width) ;
+	std::memcpy(ptr, value.data(), length);
+	std::fill(ptr + length, ptr + width, 0);
+}
+//===============================================================
+void ColumnWriter::close() {
+	if (!_output.is_open()){
+		return ;
+	}
+	writeChunk();
+	_output.close();
+	if (_written != _rows){
+		throw std::runtime_error("Column file has "s + std::to_string(_written) + " rows of "s + std::to_string(_rows));
+	}
+}
+
+/*******************************************************************************
+ ColumnFile
+ *******************************************************************************/
+//===============================================================
+ColumnFile::ColumnFile(const std::string &filepath) {
+	if (!_file.open(filepath)){
+		throw std::runtime_error("Unable to open: "s + filepath);
+	}
+	auto header = _file.span(0, header_size) ;
+	if (header.empty() || !std::equal(column_magic.begin(), column_magic.end(), header.begin())){
+		throw std::runtime_error("Not a column file: "s + filepath);
+	}
+	std::uint32_t count = 0 ;
+	std::memcpy(&_rows, header.data() + 8, 8);
+	std::memcpy(&_chunk_rows, header.data() + 16, 4);
+	std::memcpy(&count, header.data() + 20, 4);
+	auto entries = _file.span(header_size, count * column_entry_size) ;
+	if (entries.empty() || (_chunk_rows == 0)){
+		throw std::runtime_error("Not a column file: "s + filepath);
+	}
+	for (std::uint32_t index = 0 ; index < count ; index++){
+		auto entry = entries.data() + (index * column_entry_size) ;
+		auto name = reinterpret_cast<const char*>(entry) ;
+		std::uint32_t width = 0 ;
+		std::memcpy(&width, entry + column_name_size + 4, 4);
+		_columns.push_back(column_def(std::string(name, std::find(name, name + column_name_size, 0)), static_cast<ColumnType>(entry[column_name_size]), width));
+	}
+	_data_offset = padded(header_size + (count * column_entry_size)) ;
+	_chunk_size = chunkLayout(_columns, _chunk_rows) ;
+	auto last = chunks() == 0 ? 0 : chunkLayout(_columns, chunkRows(chunks() - 1)) ;
+	if (_file.size() < (_data_offset + ((chunks() == 0 ? 0 : chunks() - 1) * _chunk_size) + last)){
+		throw std::runtime_error("Column file is short: "s + filepath);
+	}
+}
+//===============================================================
+std::size_t ColumnFile::columnIndex(const std::string &name) const {
+	auto iter = std::find_if(_columns.begin(), _columns.end(), [&name](const column_def &column){
+		return column.name == name ;
+	});
+	return static_cast<std::size_t>(iter - _columns.begin()) ;
+}
+//===============================================================
+std::size_t ColumnFile::chunks() const {
+	return static_cast<std::size_t>((_rows + _chunk_rows - 1) / _chunk_rows) ;
+}
+//===============================================================
+std::size_t ColumnFile::chunkRows(std::size_t chunk) const {
+	auto first = static_cast<std::uint64_t>(chunk) * _chunk_rows ;
+	if (first >= _rows){
+		return 0 ;
+	}
+	return static_cast<std::size_t>(std::min<std::uint64_t>(_chunk_rows, _rows - first)) ;
+}
+//===============================================================
+ByteSpan ColumnFile::column(std::size_t index, std::size_t chunk) const {
+	auto rows = chunkRows(chunk) ;
+	if ((index >= _columns.size()) || (rows == 0)){
+		return ByteSpan() ;
+	}
+	std::vector<std::size_t> offsets ;
+	chunkLayout(_columns, rows, &offsets);
+	auto offset = _data_offset + (chunk * _chunk_size) + offsets[index] ;
+	return _file.span(offset, rows * _columns[index].width) ;
+}
@@ -0,0 +1,110 @@
+//Copyright © 2021 Charles Kerr. All rights reserved.
+
+#ifndef ColumnFile_hpp
+#define ColumnFile_hpp
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+
+#include "MappedFile.hpp"
+
+/******************************************************************************
+ A simple columnar table file.  Every column is fixed width (a little endian
+ integer, or nul padded text of a fixed length), and the rows are stored in
+ chunks of chunk_rows rows (the last chunk may be shorter).  Within a chunk the
+ columns follow one another, each padded to a multiple of 8 bytes:
+
+ 	header:		"UOCOLS01", u64 rows, u32 chunk_rows, u32 column count
+ 	columns:	char name[32], u8 type, u8 reserved[3], u32 width (per column)
+ 	(padding to 8 bytes)
+ 	chunks:		column 0 values, column 1 values, ... (per chunk)
+
+ As everything is fixed width, where a column of a chunk is can be computed from
+ the header alone, so the file can be mapped and the values used in place.
+ ******************************************************************************/
+//===============================================================
+enum class ColumnType : std::uint8_t {
+	uint8=1, int8, uint16, int16, uint32, int32, uint64, int64, text
+};
+//===============================================================
+struct column_def {
+	std::string name ;
+	ColumnType type ;
+	std::uint32_t width ;	// Only needed for text, the integer widths are known
+	column_def(const std::string &name = "", ColumnType type = ColumnType::uint8, std::uint32_t width = 0) ;
+	static std::uint32_t typeWidth(ColumnType type) ;
+};
+
+/******************************************************************************
+ ColumnWriter
+ 	Rows are added to the current chunk (nextRow() gives the row in the chunk,
+ and column() the storage of a column for it), and a chunk is written when it
+ is full.  The number of rows is fixed when the file is created.
+ ******************************************************************************/
+//===============================================================
+class ColumnWriter {
+private:
+	std::ofstream _output ;
+	std::vector<column_def> _columns ;
+	std::vector<std::size_t> _offsets ;	// Of each column in _chunk
+	std::vector<std::uint8_t> _chunk ;
+	std::uint64_t _rows ;
+	std::uint64_t _written ;
+	std::uint32_t _chunk_rows ;
+	std::uint32_t _filled ;
+
+	void writeChunk() ;
+public:
+	static constexpr std::uint32_t default_chunk_rows = 65536 ;
+	// Throws std::runtime_error if the file can not be created
+	ColumnWriter(const std::string &filepath, const std::vector<column_def> &columns, std::uint64_t rows, std::uint32_t chunk_rows = default_chunk_rows) ;
+	ColumnWriter(const ColumnWriter&) = delete ;
+	ColumnWriter & operator=(const ColumnWriter&) = delete ;
+	~ColumnWriter() ;
+
+	// The index (in the chunk) of the next row, writing the chunk first if it is full.
+	// Throws std::runtime_error if all the rows have been added.
+	std::size_t nextRow() ;
+	// The storage of the column in the chunk, which stays the same from chunk to chunk
+	template <typename T>
+	T * column(std::size_t index) { return reinterpret_cast<T*>(_chunk.data() + _offsets.at(index));}
+	// Text longer than the column is cut off, shorter is padded with nuls
+	void setText(std::size_t index, std::size_t row, std::string_view value) ;
+	// Writes the last chunk.  Throws std::runtime_error if not all the rows were added.
+	void close() ;
+};
+
+/******************************************************************************
+ ColumnFile
+ 	Reads a column file (mapped), the values are used in place.
+ ******************************************************************************/
+//===============================================================
+class ColumnFile {
+private:
+	MappedFile _file ;
+	std::vector<column_def> _columns ;
+	std::uint64_t _rows ;
+	std::uint32_t _chunk_rows ;
+	std::size_t _data_offset ;
+	std::size_t _chunk_size ;	// Of a full chunk
+public:
+	// Throws std::runtime_error if the file can not be read, or is not a column file
+	ColumnFile(const std::string &filepath) ;
+
+	std::uint64_t rows() const { return _rows;}
+	const std::vector<column_def> & columns() const { return _columns;}
+	// Returns columns().size() if there is no such column
+	std::size_t columnIndex(const std::string &name) const ;
+
+	std::size_t chunks() const ;
+	std::size_t chunkRows(std::size_t chunk) const ;
+	ByteSpan column(std::size_t index, std::size_t chunk) const ;
+	template <typename T>
+	const T * values(std::size_t index, std::size_t chunk) const { return reinterpret_cast<const T*>(column(index, chunk).data());}
+};
+
+#endif /* ColumnFile_hpp */
@@ -0,0 +1,149 @@
+//Copyright © 2021 Charles Kerr. All rights reserved.
+
+#include "MappedFile.hpp"
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*******************************************************************************
+ ByteSpan
+ *******************************************************************************/
+//===============================================================
+ByteSpan ByteSpan::subspan(std::size_t offset, std::size_t length) const {
+	if ((offset > _size) || (length > (_size - offset))){
+		return ByteSpan();
+	}
+	return ByteSpan(_data+offset,length);
+}
+//===============================================================
+std::vector<std::uint8_t> ByteSpan::copy() const {
+	return std::vector<std::uint8_t>(begin(),end());
+}
+
+/*******************************************************************************
+ MappedFile
+ *******************************************************************************/
+//===============================================================
+MappedFile::MappedFile(const std::string &filepath){
+	_data = nullptr ;
+	_size = 0 ;
+	_mapped = false ;
+	_open = false ;
+	if (!filepath.empty()){
+		open(filepath);
+	}
+}
+//===============================================================
+MappedFile::MappedFile(MappedFile &&other) : MappedFile() {
+	*this = std::move(other);
+}
+//===============================================================
+MappedFile & MappedFile::operator=(MappedFile &&other) {
+	if (this != &other){
+		close();
+		_contents = std::move(other._contents);
+		_mapped = other._mapped ;
+		_open = other._open ;
+		_size = other._size ;
+		_data = _mapped ? other._data : _contents.data() ;
+		other._data = nullptr ;
+		other._size = 0 ;
+		other._mapped = false ;
+		other._open = false ;
+	}
+	return *this ;
+}
+//===============================================================
+MappedFile::~MappedFile() {
+	close();
+}
+
+//===============================================================
+bool MappedFile::open(const std::string &filepath){
+	close();
+#if !defined(_WIN32)
+	auto fd = ::open(filepath.c_str(),O_RDONLY);
+	if (fd < 0){
+		return false ;
+	}
+	struct stat status ;
+	if (::fstat(fd,&status) != 0){
+		::close(fd);
+		return false ;
+	}
+	_size = static_cast<std::size_t>(status.st_size);
+	if (_size == 0){
+		// Nothing to map, but the file is there
+		::close(fd);
+		_open = true ;
+		return true ;
+	}
+	auto ptr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (ptr != MAP_FAILED){
+		_data = reinterpret_cast<const std::uint8_t*>(ptr);
+		_mapped = true ;
+		_open = true ;
+		return true ;
+	}
+	// We couldn't map it, so fall through and read it in
+#endif
+	std::ifstream input(filepath,std::ios::binary);
+	if (!input.is_open()){
+		_size = 0 ;
+		return false ;
+	}
+	_size = static_cast<std::size_t>(std::filesystem::file_size(std::filesystem::path(filepath)));
+	_contents.resize(_size,0);
+	input.read(reinterpret_cast<char*>(_contents.data()),_size);
+	if (static_cast<std::size_t>(input.gcount()) != _size){
+		_contents.clear();
+		_size = 0 ;
+		return false ;
+	}
+	_data = _contents.data();
+	_open = true ;
+	return true ;
+}
+//===============================================================
+void MappedFile::close() {
+#if !defined(_WIN32)
+	if (_mapped && (_data != nullptr)){
+		::munmap(const_cast<std::uint8_t*>(_data), _size);
+	}
+#endif
+	_contents.clear();
+	_contents.shrink_to_fit();
+	_data = nullptr ;
+	_size = 0 ;
+	_mapped = false ;
+	_open = false ;
+}
+
+//===============================================================
+ByteSpan MappedFile::span(std::size_t offset, std::size_t length) const {
+	return span().subspan(offset, length);
+}
+//===============================================================
+void MappedFile::release(std::size_t offset, std::size_t length) const {
+#if !defined(_WIN32)
+	if (!_mapped || (offset >= _size)){
+		return ;
+	}
+	length = std::min(length, _size - offset);
+	auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+	auto start = ((offset + page - 1) / page) * page ;
+	auto end = ((offset + length) / page) * page ;
+	if (start < end){
+		::madvise(const_cast<std::uint8_t*>(_data) + start, end - start, MADV_DONTNEED);
+	}
+#endif
+}
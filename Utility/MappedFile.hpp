@@ -0,0 +1,78 @@
+//Copyright © 2021 Charles Kerr. All rights reserved.
+
+#ifndef MappedFile_hpp
+#define MappedFile_hpp
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/******************************************************************************
+ ByteSpan
+ 	A non owning view of a contiguous block of bytes.  The span is only
+ valid as long as the storage it refers to (typically a MappedFile).
+ ******************************************************************************/
+//===============================================================
+class ByteSpan {
+private:
+	const std::uint8_t *_data ;
+	std::size_t _size ;
+public:
+	ByteSpan(const std::uint8_t *data = nullptr, std::size_t size = 0) : _data(data), _size(size) {}
+	ByteSpan(const std::vector<std::uint8_t> &data) : _data(data.data()), _size(data.size()) {}
+
+	const std::uint8_t * data() const { return _data;}
+	std::size_t size() const { return _size;}
+	bool empty() const { return _size == 0 ;}
+
+	const std::uint8_t * begin() const { return _data;}
+	const std::uint8_t * end() const { return _data + _size;}
+
+	const std::uint8_t & operator[](std::size_t index) const { return _data[index];}
+
+	ByteSpan subspan(std::size_t offset, std::size_t length) const ;
+	std::vector<std::uint8_t> copy() const ;
+};
+
+/******************************************************************************
+ MappedFile
+ 	A read only view of a file's contents.  Where the platform allows it,
+ the file is memory mapped, so accessing a portion of it does not require
+ a read (or a copy).  Otherwise the contents are read into memory once.
+ ******************************************************************************/
+//===============================================================
+class MappedFile {
+private:
+	const std::uint8_t *_data ;
+	std::size_t _size ;
+	bool _mapped ;
+	bool _open ;
+	std::vector<std::uint8_t> _contents ; // Only used if we could not map
+
+public:
+	MappedFile(const std::string &filepath = "");
+	MappedFile(const MappedFile&) = delete ;
+	MappedFile & operator=(const MappedFile&) = delete ;
+	MappedFile(MappedFile &&other) ;
+	MappedFile & operator=(MappedFile &&other) ;
+	~MappedFile() ;
+
+	bool open(const std::string &filepath) ;
+	void close() ;
+	bool isOpen() const { return _open;}
+	bool mapped() const { return _mapped;}
+
+	const std::uint8_t * data() const { return _data;}
+	std::size_t size() const { return _size;}
+
+	ByteSpan span() const { return ByteSpan(_data,_size);}
+	// Returns an empty span if the requested range is not within the file
+	ByteSpan span(std::size_t offset, std::size_t length) const ;
+	// Tells the system the range is not needed for now, so the pages can be dropped
+	// (they are read back in if accessed again).  Only whole pages in the range are
+	// released, nothing is done if the file is not mapped.
+	void release(std::size_t offset, std::size_t length) const ;
+};
+
+#endif /* MappedFile_hpp */
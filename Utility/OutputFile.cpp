@@ -0,0 +1,283 @@
+//Copyright © 2021 Charles Kerr. All rights reserved.
+
+#include "OutputFile.hpp"
+#include "WorkQueue.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <zlib.h>
+
+using namespace std::string_literals;
+
+//===============================================================
+// A block deflated on its own (raw deflate), and its crc
+struct deflated_block {
+	std::vector<std::uint8_t> data ;
+	std::uint32_t crc ;
+	deflated_block() : crc(0) {}
+};
+//===============================================================
+// Unless it is the last, the block ends with a sync flush (so it ends on a byte,
+// and the next block can follow it).  The dictionary is what came before it.
+static void deflateBlock(const std::vector<char> &block, const std::vector<char> &dictionary, int level, bool last, deflated_block &result) {
+	z_stream stream ;
+	std::memset(&stream, 0, sizeof(stream));
+	if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK){
+		throw std::runtime_error("Unable to initialize deflate"s);
+	}
+	if (!dictionary.empty()){
+		deflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(dictionary.data()), static_cast<uInt>(dictionary.size()));
+	}
+	result.data.resize(deflateBound(&stream, static_cast<uLong>(block.size())) + 16);
+	stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(block.data())) ;
+	stream.avail_in = static_cast<uInt>(block.size()) ;
+	auto flush = last ? Z_FINISH : Z_SYNC_FLUSH ;
+	while (true){
+		stream.next_out = result.data.data() + stream.total_out ;
+		stream.avail_out = static_cast<uInt>(result.data.size() - stream.total_out) ;
+		auto status = deflate(&stream, flush);
+		if ((status != Z_OK) && (status != Z_STREAM_END) && (status != Z_BUF_ERROR)){
+			deflateEnd(&stream);
+			throw std::runtime_error("Deflate failed"s);
+		}
+		// Room left over means it all went in (and was flushed or finished)
+		if ((stream.avail_out != 0) || (status == Z_STREAM_END)){
+			break ;
+		}
+		result.data.resize(result.data.size() * 2);
+	}
+	result.data.resize(stream.total_out);
+	deflateEnd(&stream);
+	result.crc = static_cast<std::uint32_t>(crc32(0, reinterpret_cast<const Bytef*>(block.data()), static_cast<uInt>(block.size())));
+}
+
+/*******************************************************************************
+ OutputBuffer
+ *******************************************************************************/
+//===============================================================
+OutputBuffer::OutputBuffer() {
+	_compress = false ;
+	_level = Z_DEFAULT_COMPRESSION ;
+	_queue = nullptr ;
+	_crc = 0 ;
+	_total = 0 ;
+}
+//===============================================================
+bool OutputBuffer::open(const std::string &filepath, bool compress, WorkQueue *queue, int level) {
+	close();
+	_file.open(filepath, std::ios::binary);
+	if (!_file.is_open()){
+		return false ;
+	}
+	_compress = compress ;
+	_queue = queue ;
+	_level = level ;
+	_crc = static_cast<std::uint32_t>(crc32(0, nullptr, 0)) ;
+	_total = 0 ;
+	_dictionary.clear();
+	_pending.clear();
+	if (_compress){
+		// Magic, deflate, no flags, no time, no extra flags, unix
+		constexpr std::array<std::uint8_t,10> header{0x1f,0x8b,8,0,0,0,0,0,0,3} ;
+		_file.write(reinterpret_cast<const char*>(header.data()), header.size());
+	}
+	_block.resize(_block_size);
+	setp(_block.data(), _block.data() + _block.size());
+	return true ;
+}
+//===============================================================
+bool OutputBuffer::writeBlock() {
+	auto size = static_cast<std::size_t>(pptr() - pbase()) ;
+	if (size > 0){
+		_file.write(pbase(), static_cast<std::streamsize>(size));
+		setp(_block.data(), _block.data() + _block.size());
+	}
+	return _file.good() ;
+}
+//===============================================================
+void OutputBuffer::queueBlock() {
+	auto size = static_cast<std::size_t>(pptr() - pbase()) ;
+	if (size == 0){
+		return ;
+	}
+	_pending.push_back(std::vector<char>(pbase(), pbase() + size));
+	setp(_block.data(), _block.data() + _block.size());
+	auto window = (_queue == nullptr) ? 1 : std::max<std::size_t>(_queue->threads() * 2, 1) ;
+	if (_pending.size() >= window){
+		deflatePending(false);
+	}
+}
+//===============================================================
+void OutputBuffer::deflatePending(bool last) {
+	if (_pending.empty() && !last){
+		return ;
+	}
+	if (_pending.empty()){
+		// The last block has to finish the deflate stream, even if it is empty
+		_pending.push_back(std::vector<char>());
+	}
+	std::vector<deflated_block> results(_pending.size()) ;
+	// Each block is primed with the end of the one before it
+	std::vector<std::vector<char>> dictionaries(_pending.size()) ;
+	dictionaries[0] = _dictionary ;
+	for (std::size_t index = 1 ; index < _pending.size(); index++){
+		const auto &previous = _pending[index-1] ;
+		auto size = std::min(previous.size(), _dictionary_size) ;
+		dictionaries[index].assign(previous.end() - size, previous.end());
+	}
+	for (std::size_t index = 0 ; index < _pending.size(); index++){
+		auto final_block = last && ((index + 1) == _pending.size()) ;
+		auto task = [this,&results,&dictionaries,index,final_block](){
+			deflateBlock(_pending[index], dictionaries[index], _level, final_block, results[index]);
+		};
+		if (_queue != nullptr){
+			_queue->add(task);
+		}
+		else {
+			task();
+		}
+	}
+	if (_queue != nullptr){
+		_queue->wait();
+	}
+	for (std::size_t index = 0 ; index < _pending.size(); index++){
+		_file.write(reinterpret_cast<const char*>(results[index].data.data()), results[index].data.size());
+		_crc = static_cast<std::uint32_t>(crc32_combine(_crc, results[index].crc, static_cast<z_off_t>(_pending[index].size())));
+		_total += _pending[index].size() ;
+	}
+	const auto &previous = _pending.back() ;
+	if (previous.size() >= _dictionary_size){
+		_dictionary.assign(previous.end() - _dictionary_size, previous.end());
+	}
+	else {
+		_dictionary.insert(_dictionary.end(), previous.begin(), previous.end());
+		if (_dictionary.size() > _dictionary_size){
+			_dictionary.erase(_dictionary.begin(), _dictionary.end() - _dictionary_size);
+		}
+	}
+	_pending.clear();
+}
+//===============================================================
+OutputBuffer::int_type OutputBuffer::overflow(int_type value) {
+	if (!_file.is_open()){
+		return traits_type::eof() ;
+	}
+	if (!_compress){
+		if (!writeBlock()){
+			return traits_type::eof() ;
+		}
+	}
+	else {
+		queueBlock();
+	}
+	if (!traits_type::eq_int_type(value, traits_type::eof())){
+		*pptr() = traits_type::to_char_type(value) ;
+		pbump(1);
+	}
+	return traits_type::not_eof(value) ;
+}
+//===============================================================
+std::streamsize OutputBuffer::xsputn(const char *data, std::streamsize count) {
+	// Uncompressed, anything as large as the block goes straight to the file
+	if (!_compress && (count >= static_cast<std::streamsize>(_block.size()))){
+		if (!writeBlock()){
+			return 0 ;
+		}
+		_file.write(data, count);
+		return _file.good() ? count : 0 ;
+	}
+	auto remaining = count ;
+	while (remaining > 0){
+		if (pptr() == epptr()){
+			if (!_compress){
+				if (!writeBlock()){
+					return count - remaining ;
+				}
+			}
+			else {
+				queueBlock();
+			}
+		}
+		auto amount = std::min<std::streamsize>(remaining, epptr() - pptr()) ;
+		std::memcpy(pptr(), data, static_cast<std::size_t>(amount));
+		pbump(static_cast<int>(amount));
+		data += amount ;
+		remaining -= amount ;
+	}
+	return count ;
+}
+//===============================================================
+// Compressed, the data waits for its block (a gzip member can not be flushed
+// part way without cost), so only the uncompressed data is flushed
+int OutputBuffer::sync() {
+	if (_compress || !_file.is_open()){
+		return 0 ;
+	}
+	if (!writeBlock()){
+		return -1 ;
+	}
+	_file.flush();
+	return _file.good() ? 0 : -1 ;
+}
+//===============================================================
+void OutputBuffer::close() {
+	if (!_file.is_open()){
+		return ;
+	}
+	if (_compress){
+		auto size = static_cast<std::size_t>(pptr() - pbase()) ;
+		if (size > 0){
+			_pending.push_back(std::vector<char>(pbase(), pbase() + size));
+		}
+		setp(nullptr, nullptr);
+		deflatePending(true);
+		std::array<std::uint32_t,2> trailer{_crc, static_cast<std::uint32_t>(_total & 0xFFFFFFFF)} ;
+		_file.write(reinterpret_cast<const char*>(trailer.data()), sizeof(trailer));
+		_dictionary.clear();
+	}
+	else {
+		writeBlock();
+		setp(nullptr, nullptr);
+	}
+	_block.clear();
+	_block.shrink_to_fit();
+	_file.close();
+}
+
+/*******************************************************************************
+ OutputFile
+ *******************************************************************************/
+//===============================================================
+bool OutputFile::compressed(const std::string &filepath) {
+	return (filepath.size() > 3) && (filepath.compare(filepath.size() - 3, 3, ".gz"s) == 0) ;
+}
+//===============================================================
+OutputFile::OutputFile(const std::string &filepath, WorkQueue *queue, int level) : std::ostream(nullptr) {
+	rdbuf(&_buffer);
+	if (!filepath.empty()){
+		open(filepath, queue, level);
+	}
+}
+//===============================================================
+OutputFile::~OutputFile() {
+	try {
+		_buffer.close();
+	}
+	catch (...) {
+		// Nothing can be done about it here, close() reports it
+	}
+}
+//===============================================================
+bool OutputFile::open(const std::string &filepath, WorkQueue *queue, int level) {
+	clear();
+	if (!_buffer.open(filepath, compressed(filepath), queue, level)){
+		setstate(std::ios::failbit);
+		return false ;
+	}
+	return true ;
+}
+//===============================================================
+void OutputFile::close() {
+	_buffer.close();
+}
@@ -0,0 +1,82 @@
+//Copyright © 2021 Charles Kerr. All rights reserved.
+
+#ifndef OutputFile_hpp
+#define OutputFile_hpp
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <ostream>
+#include <streambuf>
+
+class WorkQueue ;
+
+/******************************************************************************
+ OutputBuffer
+ 	The stream buffer of an OutputFile.  The data is gathered into blocks.
+ Uncompressed, a block is written to the file when it is full (or flushed).
+ Compressed, each block is deflated on its own (primed with the end of the
+ block before it), so a window of blocks can be deflated at once on the
+ threads of a WorkQueue.  The deflated blocks are written in order, and make up
+ one gzip member.
+ ******************************************************************************/
+//===============================================================
+class OutputBuffer : public std::streambuf {
+private:
+	static constexpr std::size_t _block_size = 256 * 1024 ;
+	static constexpr std::size_t _dictionary_size = 32 * 1024 ;
+
+	std::ofstream _file ;
+	bool _compress ;
+	int _level ;
+	WorkQueue *_queue ;
+	std::vector<char> _block ;
+	std::vector<std::vector<char>> _pending ;
+	std::vector<char> _dictionary ;	// The end of the last block deflated
+	std::uint32_t _crc ;
+	std::uint64_t _total ;
+
+	// Moves the data in the put area to the blocks waiting to be deflated
+	void queueBlock() ;
+	// Deflates and writes the waiting blocks (last, if they end the file)
+	void deflatePending(bool last) ;
+	// Uncompressed, writes the data in the put area to the file
+	bool writeBlock() ;
+protected:
+	int_type overflow(int_type value) override ;
+	std::streamsize xsputn(const char *data, std::streamsize count) override ;
+	int sync() override ;
+public:
+	OutputBuffer() ;
+	bool open(const std::string &filepath, bool compress, WorkQueue *queue, int level) ;
+	bool isOpen() const { return _file.is_open();}
+	void close() ;
+};
+
+/******************************************************************************
+ OutputFile
+ 	An output file stream that gzips what is written to it if the file name
+ ends in ".gz".  With a queue, the blocks are deflated on its threads (so the
+ file should not be written from a task on that queue).  The gzip member is
+ finished by close() (or the destructor).
+ ******************************************************************************/
+//===============================================================
+class OutputFile : public std::ostream {
+private:
+	OutputBuffer _buffer ;
+public:
+	static bool compressed(const std::string &filepath) ;
+
+	OutputFile(const std::string &filepath = "", WorkQueue *queue = nullptr, int level = -1) ;
+	OutputFile(const OutputFile&) = delete ;
+	OutputFile & operator=(const OutputFile&) = delete ;
+	~OutputFile() ;
+
+	bool open(const std::string &filepath, WorkQueue *queue = nullptr, int level = -1) ;
+	bool is_open() const { return _buffer.isOpen();}
+	void close() ;
+};
+
+#endif /* OutputFile_hpp */
@@ -0,0 +1,58 @@
+//Copyright © 2021 Charles Kerr. All rights reserved.
+
+#ifndef Snapshot_hpp
+#define Snapshot_hpp
+
+#include <memory>
+#include <utility>
+
+/******************************************************************************
+ Snapshot
+ 	Shares loaded data between threads.  The data is built (loaded) first, and
+ then published as a shared_ptr to const: from then on it is only read, so any
+ number of threads can use it without locking.  The const methods of the UO data
+ classes (ArtData, GumpData, TexMap, LightData, AnimationData, MultiData,
+ RadarColor, MapTerArt, TileData) do not change anything (no caches, nothing
+ loaded on demand), which is what makes that safe.  The tile data is no
+ exception: MapTerArt and MultiData hold the TileData current when they were
+ made, and the tiles they hand out are resolved with it (their tileData()), so
+ a TileData::reload() is not seen by a reader of a MapTerArt or MultiData (it
+ sees the new tile data once the map or multis are made again).
+
+ A reload builds new data and publishes it in place of the old.  Readers are
+ not blocked: get() hands out the data current at the time, and a reader keeps
+ what it has until it lets go of it (the old data is freed with its last holder).
+
+ 	Snapshot<UO::ArtData> art ;
+ 	art.load(uodir) ;				// or art.publish(built)
+ 	...
+ 	auto current = art.get() ;		// any thread
+ 	auto bitmap = current->art(tileid) ;
+ ******************************************************************************/
+//===============================================================
+template <typename T>
+class Snapshot {
+private:
+	std::shared_ptr<const T> _data ;
+public:
+	Snapshot() = default ;
+	Snapshot(std::shared_ptr<const T> data) : _data(std::move(data)) {}
+	Snapshot(const Snapshot&) = delete ;
+	Snapshot & operator=(const Snapshot&) = delete ;
+
+	// The data current at the time of the call (nullptr if none was published)
+	std::shared_ptr<const T> get() const { return std::atomic_load(&_data);}
+	// Returns the data it replaced
+	std::shared_ptr<const T> publish(std::shared_ptr<const T> data) {
+		return std::atomic_exchange(&_data, std::move(data));
+	}
+	// Builds T from the arguments (before anything is swapped), and publishes it
+	template <typename... Args>
+	std::shared_ptr<const T> load(Args&&... args) {
+		auto data = std::make_shared<const T>(std::forward<Args>(args)...) ;
+		publish(data);
+		return data ;
+	}
+};
+
+#endif /* Snapshot_hpp */
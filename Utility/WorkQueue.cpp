@@ -0,0 +1,86 @@
+//Copyright © 2021 Charles Kerr. All rights reserved.
+
+#include "WorkQueue.hpp"
+#include <utility>
+
+//===============================================================
+WorkQueue::WorkQueue(std::size_t threads, std::size_t capacity){
+	_active = 0 ;
+	_stop = false ;
+	_capacity = (capacity == 0) ? threads * 4 : capacity ;
+	if (threads > 1) {
+		for (std::size_t i = 0 ; i < threads ; i++){
+			_threads.push_back(std::thread(&WorkQueue::run, this));
+		}
+	}
+}
+//===============================================================
+WorkQueue::~WorkQueue() {
+	{
+		// Tasks not yet started are dropped (what they use may already be gone,
+		// if the queue is being destroyed by an exception), only those running finish
+		std::lock_guard<std::mutex> guard(_lock);
+		_tasks.clear();
+		_stop = true ;
+	}
+	_task_available.notify_all();
+	for (auto &thread : _threads){
+		thread.join();
+	}
+}
+//===============================================================
+void WorkQueue::run() {
+	while (true) {
+		std::function<void()> task ;
+		{
+			std::unique_lock<std::mutex> guard(_lock);
+			_task_available.wait(guard, [this](){ return _stop || !_tasks.empty();});
+			if (_tasks.empty()){
+				return ;
+			}
+			task = std::move(_tasks.front());
+			_tasks.pop_front();
+			_active++ ;
+		}
+		_space_available.notify_one();
+		try {
+			task();
+		}
+		catch (...){
+			std::lock_guard<std::mutex> guard(_lock);
+			if (!_error){
+				_error = std::current_exception();
+			}
+		}
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+			_active-- ;
+		}
+		_idle.notify_all();
+	}
+}
+//===============================================================
+void WorkQueue::add(std::function<void()> task) {
+	if (_threads.empty()){
+		task();
+		return ;
+	}
+	{
+		std::unique_lock<std::mutex> guard(_lock);
+		_space_available.wait(guard, [this](){ return _tasks.size() < _capacity;});
+		_tasks.push_back(std::move(task));
+	}
+	_task_available.notify_one();
+}
+//===============================================================
+void WorkQueue::wait() {
+	std::exception_ptr error ;
+	{
+		std::unique_lock<std::mutex> guard(_lock);
+		_idle.wait(guard, [this](){ return _tasks.empty() && (_active == 0);});
+		std::swap(error, _error);
+	}
+	if (error){
+		std::rethrow_exception(error);
+	}
+}
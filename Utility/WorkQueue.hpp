@@ -0,0 +1,52 @@
+//Copyright © 2021 Charles Kerr. All rights reserved.
+
+#ifndef WorkQueue_hpp
+#define WorkQueue_hpp
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <exception>
+
+/******************************************************************************
+ WorkQueue
+ 	Runs tasks on a fixed number of threads.  The queue is bounded, add()
+ blocks until there is room, so the producer can not get far ahead of the
+ workers (and memory stays flat).  With one thread (or less) tasks are run
+ immediately on the calling thread.  The first exception thrown by a task is
+ rethrown by wait().  Destroying the queue discards the tasks that have not
+ started, so call wait() first if they have to run.
+ ******************************************************************************/
+//===============================================================
+class WorkQueue {
+private:
+	std::vector<std::thread> _threads ;
+	std::deque<std::function<void()>> _tasks ;
+	std::size_t _capacity ;
+	std::size_t _active ;
+	bool _stop ;
+	std::exception_ptr _error ;
+	std::mutex _lock ;
+	std::condition_variable _task_available ;
+	std::condition_variable _space_available ;
+	std::condition_variable _idle ;
+	
+	void run() ;
+public:
+	WorkQueue(std::size_t threads, std::size_t capacity = 0) ;
+	WorkQueue(const WorkQueue&) = delete ;
+	WorkQueue & operator=(const WorkQueue&) = delete ;
+	~WorkQueue() ;
+	
+	std::size_t threads() const { return _threads.size();}
+	void add(std::function<void()> task) ;
+	// Waits for all the tasks added so far to complete
+	void wait() ;
+};
+
+#endif /* WorkQueue_hpp */
@@ -28,6 +28,21 @@
  		--texture (produce the textures)
  		--gumps (produce the gump artwork)
  
+ 	The artwork (terrain, art, textures, gumps, animations, lights) can be converted
+ 	and saved on several threads with --jobs N.  The maps (--map0 ... --map5) are
+ 	also loaded together, and the radar, terrain and art output of each split across
+ 	the threads.  The output is the same as with one job (the default).
+ 	--radartiles also writes each radar map as a pyramid of 256x256 tiles (in
+ 	maps/mapN/tiles/level/x/y.bmp), --radartiles-update only rewrites the tiles
+ 	the map/static diffs touch now, or touched when the tiles were last written
+ 	(kept in maps/mapN/tiles/changed.blocks).
+ 	--columns also writes the terrain and statics of each map as column files
+ 	(maps/mapN/terrain.cols and art.cols, see ColumnFile.hpp) that can be mapped and
+ 	used in place, with the tile information in maps/tiledata_terrain.cols and
+ 	maps/tiledata_art.cols.
+ 	--gzip gzips the csv files and the bitmaps (adding .gz to their names), the large
+ 	files are deflated a block at a time across the threads.
+ 
  	For the terrain/art,gumps: if they have uop versions, those are used first. If
  	the uop file can not be found, then the idx/mul file is used if appropriate.
  
@@ -41,6 +56,9 @@
 #include <string>
 #include <stdexcept>
 #include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include "StringUtility.hpp"
 #include "TileData.hpp"
@@ -52,6 +70,10 @@
 #include "MapTerArt.hpp"
 #include "LightData.hpp"
 #include "RadarColor.hpp"
+#include "WorkQueue.hpp"
+#include "CSVWriter.hpp"
+#include "OutputFile.hpp"
+#include "UOAlerts.hpp"
 
 using namespace std::string_literals;
 
@@ -70,6 +92,14 @@ bool _map4 = false ;
 bool _map5 = false ;
 bool _multi = false ;
 bool _light = false;
+std::size_t _jobs = 1 ;
+// Radar tile pyramids (all the tiles, or only those changed by the diffs)
+bool _radartiles = false ;
+bool _radartiles_update = false ;
+// Column files of the maps (and the tile information), beside the csv files
+bool _columns = false ;
+// The csv files and bitmaps are gzipped
+bool _gzip = false ;
 
 std::map<std::string,bool*> _flags {
 	{"--info"s,&_info},{"--terrain"s,&_terrain},{"--art"s, &_art},
@@ -78,10 +108,101 @@ std::map<std::string,bool*> _flags {
 	{"--map4"s,&_map4},{"--map5"s,&_map5},{"--multi"s,&_multi},{"--light"s,&_light}
 };
 
+// The maps (facets) that can be extracted, and the flag that selects each
+const std::vector<std::pair<std::size_t,bool*>> _facets {
+	{0,&_map0},{1,&_map1},{2,&_map2},{3,&_map3},{4,&_map4},{5,&_map5}
+};
+
+//===============================================================
+// Status lines come from several threads, so they are written whole
+std::mutex _status_lock ;
+void status(const std::string &message){
+	std::lock_guard<std::mutex> lock(_status_lock);
+	std::cout << message << std::endl;
+}
+//===============================================================
+// With --gzip, ".gz" is added to the name (and OutputFile gzips the file)
+std::string outputName(const std::string &name){
+	return _gzip ? name + ".gz"s : name ;
+}
+//===============================================================
+// The csv text of each tile's information, made once rather than for every cell
+struct csv_rows {
+	std::vector<std::string> terrain ;
+	std::vector<std::string> art ;
+	std::string empty ;
+	csv_rows(const UO::TileInfo &tiledata) ;
+	const std::string & terrainRow(UO::tileid_t tileid) const ;
+	const std::string & artRow(UO::tileid_t tileid) const ;
+};
+//===============================================================
+csv_rows::csv_rows(const UO::TileInfo &tiledata) {
+	terrain.reserve(tiledata.sizeTerrain());
+	for (std::size_t tileid = 0 ; tileid < tiledata.sizeTerrain(); tileid++){
+		terrain.push_back(tiledata.terrain(tileid).csvRow());
+	}
+	art.reserve(tiledata.sizeArt());
+	for (std::size_t tileid = 0 ; tileid < tiledata.sizeArt(); tileid++){
+		art.push_back(tiledata.art(tileid).csvRow());
+	}
+	empty = UO::tile_info().csvRow() ;
+}
+//===============================================================
+const std::string & csv_rows::terrainRow(UO::tileid_t tileid) const {
+	if (tileid == UO::invalid_tileid){
+		return empty ;
+	}
+	if (tileid >= terrain.size()){
+		throw UO::InvalidTileID("terrain", tileid);
+	}
+	return terrain[tileid] ;
+}
+//===============================================================
+const std::string & csv_rows::artRow(UO::tileid_t tileid) const {
+	if (tileid >= art.size()){
+		throw UO::InvalidTileID("art", tileid);
+	}
+	return art[tileid] ;
+}
+//===============================================================
+// The rows of the map are formatted in ranges (on the queue's threads, if given)
+void saveTerrainInfo(const UO::MapTerArt &mapdata, const csv_rows &rows, const std::string &filepath, WorkQueue *queue = nullptr){
+	CSVWriter output(filepath, queue) ;
+	UO::tile_info infostub ;
+	infostub.type = UO::TileType::terrain ;
+	output.buffer().text("y,x,z,tileid,"s + infostub.csvTitle()).endRow();
+	output.writeRows(mapdata.mapHeight(), [&mapdata,&rows](std::size_t row, CSVBuffer &buffer){
+		auto y = static_cast<std::int32_t>(row) ;
+		for (std::int32_t x=0;x<static_cast<std::int32_t>(mapdata.mapWidth());x++){
+			auto tileid = mapdata.terrainID(x, y) ;
+			buffer.number(y).comma().number(x).comma().number(mapdata.terrainAltitude(x, y)).comma();
+			buffer.hex(tileid).comma().text(rows.terrainRow(tileid)).endRow();
+		}
+	}, queue, 8);
+	output.close();
+}
+//===============================================================
+void saveArtInfo(const UO::MapTerArt &mapdata, const csv_rows &rows, const std::string &filepath, WorkQueue *queue = nullptr){
+	CSVWriter output(filepath, queue) ;
+	UO::tile_info infostub ;
+	infostub.type = UO::TileType::art;
+	output.buffer().text("y,x,z,tileid,static hue,"s + infostub.csvTitle()).endRow();
+	output.writeRows(mapdata.mapHeight(), [&mapdata,&rows](std::size_t row, CSVBuffer &buffer){
+		auto y = static_cast<std::int32_t>(row) ;
+		for (std::int32_t x=0;x<static_cast<std::int32_t>(mapdata.mapWidth());x++){
+			for (const auto &entry: mapdata.statics(x, y)){
+				buffer.number(y).comma().number(x).comma().number(entry.z).comma();
+				buffer.hex(entry.hue).comma().text(rows.artRow(entry.tileid)).endRow();
+			}
+		}
+	}, queue, 8);
+	output.close();
+}
+
 int main(int argc, const char * argv[]) {
 	
 	if (argc < 3) {
-		std::cerr <<"Usage: extractUO uo_directory output_directory [--info] [--terrain] [--art] --texture] [--gump]"s << std::endl;
+		std::cerr <<"Usage: extractUO uo_directory output_directory [--info] [--terrain] [--art] --texture] [--gump] [--jobs N] [--radartiles | --radartiles-update] [--columns] [--gzip]"s << std::endl;
 		return EXIT_FAILURE;
 	}
 	auto uodir = std::filesystem::path(std::string(argv[1])) ;
@@ -95,30 +216,56 @@ int main(int argc, const char * argv[]) {
 		return EXIT_FAILURE;
 	}
 	// We now have the directories!
-	if (argc == 3) {
+	// Ok, we now search for the flag that where specified
+	auto flagcount = 0 ;
+	for (auto i=3 ; i < argc; i++) {
+		auto flag = std::string(argv[i]);
+		if (flag == "--jobs"s){
+			if ((i+1) >= argc){
+				std::cerr <<"Missing count for: " << flag << std::endl;
+				return EXIT_FAILURE;
+			}
+			_jobs = static_cast<std::size_t>(std::max(strutil::strtoi(std::string(argv[++i])),1));
+			continue ;
+		}
+		if (flag == "--radartiles"s){
+			_radartiles = true ;
+			continue ;
+		}
+		if (flag == "--radartiles-update"s){
+			_radartiles_update = true ;
+			continue ;
+		}
+		if (flag == "--columns"s){
+			_columns = true ;
+			continue ;
+		}
+		if (flag == "--gzip"s){
+			_gzip = true ;
+			continue ;
+		}
+		auto iter = _flags.find(flag) ;
+		if (iter == _flags.end()){
+			std::cerr <<"Unknown flag: " << flag << std::endl;
+			return EXIT_FAILURE;
+		}
+		*(iter->second) = true ;
+		flagcount++ ;
+	}
+	if (flagcount == 0) {
 		// we are doing everything!
 		for (auto &[name,addr] : _flags){
 			*addr = true ;
 		}
 	}
-	else {
-		// Ok, we now search for the flag that where specified
-		for (auto i=3 ; i < argc; i++) {
-			auto flag = std::string(argv[i]);
-			auto iter = _flags.find(flag) ;
-			if (iter == _flags.end()){
-				std::cerr <<"Unknown flag: " << flag << std::endl;
-				return EXIT_FAILURE;
-			}
-			*(iter->second) = true ;
-		}
-	}
 	
 	
 	try {
+		// Conversion and saving of the artwork is queued, so it can be done on several threads
+		WorkQueue queue(_jobs) ;
 		// Now, lets process!
 		std::cout <<"Loading tile information" << std::endl;
-		UO::TileData::shared(uodir.string());
+		auto tiledata = UO::TileData::current(uodir.string());
 		if (_info || _art || _terrain){
 			std::cout <<"Loading artwork (also needed for --info)" << std::endl;
 			UO::ArtData artwork(uodir.string());
@@ -127,17 +274,17 @@ int main(int argc, const char * argv[]) {
 				if (!std::filesystem::exists(path)){
 					std::filesystem::create_directory(path);
 				}
-				auto terinfo = path / std::filesystem::path("terrain.csv"s);
-				auto artinfo = path / std::filesystem::path("art.csv"s);
+				auto terinfo = path / std::filesystem::path(outputName("terrain.csv"s));
+				auto artinfo = path / std::filesystem::path(outputName("art.csv"s));
 				// output the terrain info
-				std::ofstream output(terinfo.string()) ;
+				OutputFile output(terinfo.string(), &queue) ;
 				std::cout <<"Extracting Terrain info" << std::endl;
 				if (!output.is_open()){
 					std::cerr <<"Unable to open: "s << terinfo.string()<<std::endl;
 					return EXIT_FAILURE;
 				}
 				for (auto i= 0 ; i < 0x4000;i++){
-					auto info = UO::TileData::shared().terrain(i);
+					const auto &info = tiledata->terrain(i);
 					auto hasart = artwork.hasTerrain(i);
 					if (i==0) {
 						output << "Tile ID," << info.csvTitle()<<",Artwork"<<std::endl;
@@ -148,14 +295,14 @@ int main(int argc, const char * argv[]) {
 				
 				// output the art info
 				std::cout <<"Extracting Art info" << std::endl;
-				output.open(artinfo.string()) ;
+				output.open(artinfo.string(), &queue) ;
 				if (!output.is_open()){
 					std::cerr <<"Unable to open: "s << artinfo.string()<<std::endl;
 					return EXIT_FAILURE;
 				}
 				
 				for (auto i= 0 ; i < 0xFFFF;i++){
-					auto info = UO::TileData::shared().art(i);
+					const auto &info = tiledata->art(i);
 					auto hasart = artwork.hasArt(i);
 					if (i==0) {
 						output << "Tile ID," << info.csvTitle()<<",Artwork"<<std::endl;
@@ -174,11 +321,14 @@ int main(int argc, const char * argv[]) {
 				auto maxterrain = artwork.maxTerrain();
 				for (auto i= 0 ; i< maxterrain;i++){
 					if (artwork.hasTerrain(i)){
-						auto bitmap = artwork.terrain(i);
-						auto filename = path / std::filesystem::path(strutil::numtostr(i,16,true,4)+".bmp"s);
-						bitmap.save(filename.string());
+						queue.add([&artwork,path,i](){
+							auto bitmap = artwork.terrain(i);
+							auto filename = path / std::filesystem::path(outputName(strutil::numtostr(i,16,true,4)+".bmp"s));
+							bitmap.save(filename.string());
+						});
 					}
 				}
+				queue.wait();
 			}
 			if (_art){
 				std::cout <<"Extracting Art artwork" << std::endl;
@@ -189,11 +339,14 @@ int main(int argc, const char * argv[]) {
 				auto maxart = artwork.maxArt();
 				for (auto i= 0 ; i< maxart;i++){
 					if (artwork.hasArt(i)){
-						auto bitmap = artwork.art(i);
-						auto filename = path / std::filesystem::path(strutil::numtostr(i,16,true,4)+".bmp"s);
-						bitmap.save(filename.string());
+						queue.add([&artwork,path,i](){
+							auto bitmap = artwork.art(i);
+							auto filename = path / std::filesystem::path(outputName(strutil::numtostr(i,16,true,4)+".bmp"s));
+							bitmap.save(filename.string());
+						});
 					}
 				}
+				queue.wait();
 			}
 			
 		}
@@ -208,11 +361,14 @@ int main(int argc, const char * argv[]) {
 			}
 			for (auto i= 0 ; i< maxid;i++){
 				if (texture.hasTexture(i)){
-					auto bitmap = texture.texture(i);
-					auto filename = path / std::filesystem::path(strutil::numtostr(i,16,true,4)+".bmp"s);
-					bitmap.save(filename.string());
+					queue.add([&texture,path,i](){
+						auto bitmap = texture.texture(i);
+						auto filename = path / std::filesystem::path(outputName(strutil::numtostr(i,16,true,4)+".bmp"s));
+						bitmap.save(filename.string());
+					});
 				}
 			}
+			queue.wait();
 		}
 		if (_gump){
 			std::cout <<"Loading Gumps"<<std::endl;
@@ -225,11 +381,14 @@ int main(int argc, const char * argv[]) {
 			}
 			for (auto i= 0 ; i< maxid;i++){
 				if (gumps.hasGump(i)){
-					auto bitmap = gumps.gump(i);
-					auto filename = path / std::filesystem::path(strutil::numtostr(i,16,true,4)+".bmp"s);
-					bitmap.save(filename.string());
+					queue.add([&gumps,path,i](){
+						auto bitmap = gumps.gump(i);
+						auto filename = path / std::filesystem::path(outputName(strutil::numtostr(i,16,true,4)+".bmp"s));
+						bitmap.save(filename.string());
+					});
 				}
 			}
+			queue.wait();
 		}
 		if (_animation){
 			auto animpath = outputdir / std::filesystem::path("animations"s);
@@ -250,307 +409,97 @@ int main(int argc, const char * argv[]) {
 					}
 					std::cout <<"Loading Animation data: "<<i<<std::endl;
 					UO::AnimationData  data(uodir,i);
-					auto maxid = data.maxID();
 					std::cout <<"Extracting Animation data: "<<i<<std::endl;
-					for (auto j= 0 ; j<maxid;j++){
-						if (data.hasAnimation(j)){
-							auto anpath = path / std::filesystem::path("animID-"+strutil::numtostr(j,16,true,4));
-							if (!std::filesystem::exists(anpath)){
-								std::filesystem::create_directory(anpath);
-							}
-							auto frames = data.animation(j);
-							for (auto k=0;k<frames.size();k++){
-								auto path = anpath / std::filesystem::path("frame-"s+std::to_string(k));
-								frames[k].save(path.string());
-							}
+					// Visit the records in file order, so the mul is read front to back
+					data.stream([&path](std::size_t j, std::vector<IMG::Bitmap> &frames){
+						auto anpath = path / std::filesystem::path("animID-"+strutil::numtostr(j,16,true,4));
+						if (!std::filesystem::exists(anpath)){
+							std::filesystem::create_directory(anpath);
 						}
-					}
+						for (auto k=0;k<frames.size();k++){
+							auto framepath = anpath / std::filesystem::path(outputName("frame-"s+std::to_string(k)));
+							frames[k].save(framepath.string());
+						}
+					}, &queue);
 				}
 				
 			}
 		}
-		if (_map0 || _map1 || _map2 || _map3 || _map4 || _map5){
-			std::cout <<"Loading radar colors" << std::endl;
-			UO::RadarColor palette(uodir.string());
+		if (std::any_of(_facets.begin(), _facets.end(), [](const auto &entry){return *(entry.second);})){
+			status("Loading radar colors"s);
+			const UO::RadarColor palette(uodir.string());
 			auto path = outputdir / std::filesystem::path("maps");
 			if (!std::filesystem::exists(path)){
 				std::filesystem::create_directory(path);
 			}
-			if (_map0){
-				auto mappath = path / std::filesystem::path("map0");
-				if (!std::filesystem::exists(mappath)){
-					std::filesystem::create_directory(mappath);
-				}
-				auto radarpath = mappath / std::filesystem::path("radar.bmp");
-				auto terrainpath = mappath/std::filesystem::path("terrain.csv");
-				auto artpath = mappath/std::filesystem::path("art.csv");
-				UO::MapTerArt mapdata(0,0,0) ;
-				std::cout <<"Loading map 0 data"<<std::endl;
-				mapdata.load(uodir.string());
-				if (!mapdata.uop()){
-					mapdata.applyTerrainDiff(uodir.string(), uodir.string());
+			// The terrain and statics of each facet are loaded on their own tasks, and
+			// then its terrain and art output are each a task.  The palette and tile data are only read.
+			std::vector<std::pair<std::size_t,std::unique_ptr<UO::MapTerArt>>> facets ;
+			for (const auto &[mapnumber,flag] : _facets){
+				if (*flag){
+					facets.push_back(std::make_pair(mapnumber, std::make_unique<UO::MapTerArt>(mapnumber,0,0)));
 				}
-				mapdata.applyArtDiff(uodir.string(), uodir.string(), uodir.string());
-				std::cout <<"\tExtracting radar map" << std::endl;
-				auto bitmap = mapdata.radar(palette);
-				bitmap.save(radarpath.string());
-				std::cout <<"\tExtracting terrain info" << std::endl;
-				std::ofstream output(terrainpath.string()) ;
-				UO::tile_info infostub ;
-				infostub.type = UO::TileType::terrain ;
-				output <<"y,x,z,tileid,"<<infostub.csvTitle()<<std::endl;
-				for (auto y=0; y < mapdata.mapHeight();y++){
-					for (auto x=0;x<mapdata.mapWidth();x++){
-						auto tile = mapdata.terrain(x, y);
-						output << y<<","<<x<<","<<tile.z<<","<<strutil::numtostr(tile.tileid,16,true,4)<<","<<tile.info.csvRow()<<std::endl;
-					}
-				}
-				output.close();
-				// now do the art work
-				std::cout <<"\tExtracting art info" << std::endl;
-				output.open(artpath.string());
-				infostub.type = UO::TileType::art;
-				output <<"y,x,z,tileid,static hue,"<<infostub.csvTitle()<<std::endl;
-				for (auto y=0; y < mapdata.mapHeight();y++){
-					for (auto x=0;x<mapdata.mapWidth();x++){
-						auto tiles = mapdata.art(x, y);
-						for (const auto &entry: tiles){
-							output<<y<<","<<x<<","<<entry.z<<","<<strutil::numtostr(entry.artHue,16,true,4)<<","<<entry.info.csvRow()<<std::endl;
-						}
-					}
-				}
-				output.close();
-
 			}
-			if (_map1){
-				auto mappath = path / std::filesystem::path("map1");
-				if (!std::filesystem::exists(mappath)){
-					std::filesystem::create_directory(mappath);
-				}
-				auto radarpath = mappath / std::filesystem::path("radar.bmp");
-				auto terrainpath = mappath/std::filesystem::path("terrain.csv");
-				auto artpath = mappath/std::filesystem::path("art.csv");
-				UO::MapTerArt mapdata(1,0,0) ;
-				std::cout <<"Loading map 1 data"<<std::endl;
-				mapdata.load(uodir.string());
-				if (!mapdata.uop()){
-					mapdata.applyTerrainDiff(uodir.string(), uodir.string());
-				}
-				mapdata.applyArtDiff(uodir.string(), uodir.string(), uodir.string());
-				std::cout <<"\tExtracting radar map" << std::endl;
-				auto bitmap = mapdata.radar(palette);
-				bitmap.save(radarpath.string());
-				std::cout <<"\tExtracting terrain info" << std::endl;
-				std::ofstream output(terrainpath.string()) ;
-				UO::tile_info infostub ;
-				infostub.type = UO::TileType::terrain ;
-				output <<"y,x,z,tileid,"<<infostub.csvTitle()<<std::endl;
-				for (auto y=0; y < mapdata.mapHeight();y++){
-					for (auto x=0;x<mapdata.mapWidth();x++){
-						auto tile = mapdata.terrain(x, y);
-						output << y<<","<<x<<","<<tile.z<<","<<strutil::numtostr(tile.tileid,16,true,4)<<","<<tile.info.csvRow()<<std::endl;
+			for (auto &[mapnumber,mapdata] : facets){
+				// The terrain and statics are independent of each other
+				queue.add([&uodir,mapnumber = mapnumber,facet = mapdata.get()](){
+					status("Loading map "s + std::to_string(mapnumber) + " terrain"s);
+					facet->loadTerrain(uodir.string());
+					if (!facet->uop()){
+						facet->applyTerrainDiff(uodir.string(), uodir.string());
 					}
-				}
-				output.close();
-				// now do the art work
-				std::cout <<"\tExtracting art info" << std::endl;
-				output.open(artpath.string());
-				infostub.type = UO::TileType::art;
-				output <<"y,x,z,tileid,static hue,"<<infostub.csvTitle()<<std::endl;
-				for (auto y=0; y < mapdata.mapHeight();y++){
-					for (auto x=0;x<mapdata.mapWidth();x++){
-						auto tiles = mapdata.art(x, y);
-						for (const auto &entry: tiles){
-							output<<y<<","<<x<<","<<entry.z<<","<<strutil::numtostr(entry.artHue,16,true,4)<<","<<entry.info.csvRow()<<std::endl;
-						}
-					}
-				}
-				output.close();
-				
-			}
-			if (_map2){
-				auto mappath = path / std::filesystem::path("map2");
-				if (!std::filesystem::exists(mappath)){
-					std::filesystem::create_directory(mappath);
-				}
-				auto radarpath = mappath / std::filesystem::path("radar.bmp");
-				auto terrainpath = mappath/std::filesystem::path("terrain.csv");
-				auto artpath = mappath/std::filesystem::path("art.csv");
-				UO::MapTerArt mapdata(2,0,0) ;
-				std::cout <<"Loading map 2 data"<<std::endl;
-				mapdata.load(uodir.string());
-				if (!mapdata.uop()){
-					mapdata.applyTerrainDiff(uodir.string(), uodir.string());
-				}
-				mapdata.applyArtDiff(uodir.string(), uodir.string(), uodir.string());
-				std::cout <<"\tExtracting radar map" << std::endl;
-				auto bitmap = mapdata.radar(palette);
-				bitmap.save(radarpath.string());
-				std::cout <<"\tExtracting terrain info" << std::endl;
-				std::ofstream output(terrainpath.string()) ;
-				UO::tile_info infostub ;
-				infostub.type = UO::TileType::terrain ;
-				output <<"y,x,z,tileid,"<<infostub.csvTitle()<<std::endl;
-				for (auto y=0; y < mapdata.mapHeight();y++){
-					for (auto x=0;x<mapdata.mapWidth();x++){
-						auto tile = mapdata.terrain(x, y);
-						output << y<<","<<x<<","<<tile.z<<","<<strutil::numtostr(tile.tileid,16,true,4)<<","<<tile.info.csvRow()<<std::endl;
-					}
-				}
-				output.close();
-				// now do the art work
-				std::cout <<"\tExtracting art info" << std::endl;
-				output.open(artpath.string());
-				infostub.type = UO::TileType::art;
-				output <<"y,x,z,tileid,static hue,"<<infostub.csvTitle()<<std::endl;
-				for (auto y=0; y < mapdata.mapHeight();y++){
-					for (auto x=0;x<mapdata.mapWidth();x++){
-						auto tiles = mapdata.art(x, y);
-						for (const auto &entry: tiles){
-							output<<y<<","<<x<<","<<entry.z<<","<<strutil::numtostr(entry.artHue,16,true,4)<<","<<entry.info.csvRow()<<std::endl;
-						}
-					}
-				}
-				output.close();
-				
-			}
-			if (_map3){
-				auto mappath = path / std::filesystem::path("map3");
-				if (!std::filesystem::exists(mappath)){
-					std::filesystem::create_directory(mappath);
-				}
-				auto radarpath = mappath / std::filesystem::path("radar.bmp");
-				auto terrainpath = mappath/std::filesystem::path("terrain.csv");
-				auto artpath = mappath/std::filesystem::path("art.csv");
-				UO::MapTerArt mapdata(3,0,0) ;
-				std::cout <<"Loading map 3 data"<<std::endl;
-				mapdata.load(uodir.string());
-				if (!mapdata.uop()){
-					mapdata.applyTerrainDiff(uodir.string(), uodir.string());
-				}
-				mapdata.applyArtDiff(uodir.string(), uodir.string(), uodir.string());
-				std::cout <<"\tExtracting radar map" << std::endl;
-				auto bitmap = mapdata.radar(palette);
-				bitmap.save(radarpath.string());
-				std::cout <<"\tExtracting terrain info" << std::endl;
-				std::ofstream output(terrainpath.string()) ;
-				UO::tile_info infostub ;
-				infostub.type = UO::TileType::terrain ;
-				output <<"y,x,z,tileid,"<<infostub.csvTitle()<<std::endl;
-				for (auto y=0; y < mapdata.mapHeight();y++){
-					for (auto x=0;x<mapdata.mapWidth();x++){
-						auto tile = mapdata.terrain(x, y);
-						output << y<<","<<x<<","<<tile.z<<","<<strutil::numtostr(tile.tileid,16,true,4)<<","<<tile.info.csvRow()<<std::endl;
-					}
-				}
-				output.close();
-				// now do the art work
-				std::cout <<"\tExtracting art info" << std::endl;
-				output.open(artpath.string());
-				infostub.type = UO::TileType::art;
-				output <<"y,x,z,tileid,static hue,"<<infostub.csvTitle()<<std::endl;
-				for (auto y=0; y < mapdata.mapHeight();y++){
-					for (auto x=0;x<mapdata.mapWidth();x++){
-						auto tiles = mapdata.art(x, y);
-						for (const auto &entry: tiles){
-							output<<y<<","<<x<<","<<entry.z<<","<<strutil::numtostr(entry.artHue,16,true,4)<<","<<entry.info.csvRow()<<std::endl;
-						}
-					}
-				}
-				output.close();
-				
+				});
+				queue.add([&uodir,mapnumber = mapnumber,facet = mapdata.get()](){
+					status("Loading map "s + std::to_string(mapnumber) + " statics"s);
+					facet->loadArt(uodir.string(), uodir.string());
+					facet->applyArtDiff(uodir.string(), uodir.string(), uodir.string());
+				});
 			}
-			if (_map4){
-				auto mappath = path / std::filesystem::path("map4");
+			queue.wait();
+			// Each output is split across the queue's threads (the radar by rows of blocks,
+			// the csv files by ranges of map rows), so they are made one after the other
+			status("Formatting tile information"s);
+			const csv_rows rows(*tiledata) ;
+			for (auto &[mapnumber,mapdata] : facets){
+				auto mappath = path / std::filesystem::path("map"s + std::to_string(mapnumber));
 				if (!std::filesystem::exists(mappath)){
 					std::filesystem::create_directory(mappath);
 				}
-				auto radarpath = mappath / std::filesystem::path("radar.bmp");
-				auto terrainpath = mappath/std::filesystem::path("terrain.csv");
-				auto artpath = mappath/std::filesystem::path("art.csv");
-				UO::MapTerArt mapdata(4,0,0) ;
-				std::cout <<"Loading map 4 data"<<std::endl;
-				mapdata.load(uodir.string());
-				if (!mapdata.uop()){
-					mapdata.applyTerrainDiff(uodir.string(), uodir.string());
-				}
-				mapdata.applyArtDiff(uodir.string(), uodir.string(), uodir.string());
-				std::cout <<"\tExtracting radar map" << std::endl;
-				auto bitmap = mapdata.radar(palette);
-				bitmap.save(radarpath.string());
-				std::cout <<"\tExtracting terrain info" << std::endl;
-				std::ofstream output(terrainpath.string()) ;
-				UO::tile_info infostub ;
-				infostub.type = UO::TileType::terrain ;
-				output <<"y,x,z,tileid,"<<infostub.csvTitle()<<std::endl;
-				for (auto y=0; y < mapdata.mapHeight();y++){
-					for (auto x=0;x<mapdata.mapWidth();x++){
-						auto tile = mapdata.terrain(x, y);
-						output << y<<","<<x<<","<<tile.z<<","<<strutil::numtostr(tile.tileid,16,true,4)<<","<<tile.info.csvRow()<<std::endl;
-					}
-				}
-				output.close();
-				// now do the art work
-				std::cout <<"\tExtracting art info" << std::endl;
-				output.open(artpath.string());
-				infostub.type = UO::TileType::art;
-				output <<"y,x,z,tileid,static hue,"<<infostub.csvTitle()<<std::endl;
-				for (auto y=0; y < mapdata.mapHeight();y++){
-					for (auto x=0;x<mapdata.mapWidth();x++){
-						auto tiles = mapdata.art(x, y);
-						for (const auto &entry: tiles){
-							output<<y<<","<<x<<","<<entry.z<<","<<strutil::numtostr(entry.artHue,16,true,4)<<","<<entry.info.csvRow()<<std::endl;
-						}
-					}
+				auto radarpath = mappath / std::filesystem::path(outputName("radar.bmp"s));
+				auto terrainpath = mappath/std::filesystem::path(outputName("terrain.csv"s));
+				auto artpath = mappath/std::filesystem::path(outputName("art.csv"s));
+				auto tilepath = mappath / std::filesystem::path("tiles"s);
+				auto facet = mapdata.get() ;
+				auto name = "map "s + std::to_string(mapnumber) ;
+				status("\tExtracting radar map ("s + name + ")"s);
+				facet->saveRadar(radarpath.string(), palette, true, &queue);
+				if (_radartiles){
+					status("\tExtracting radar tiles ("s + name + ")"s);
+					facet->saveRadarTiles(tilepath.string(), palette, 256, true, &queue);
+				}
+				else if (_radartiles_update){
+					status("\tUpdating radar tiles ("s + name + ")"s);
+					facet->updateRadarTiles(tilepath.string(), palette, 256, true, &queue);
+				}
+				status("\tExtracting terrain info ("s + name + ")"s);
+				saveTerrainInfo(*facet, rows, terrainpath.string(), &queue);
+				status("\tExtracting art info ("s + name + ")"s);
+				saveArtInfo(*facet, rows, artpath.string(), &queue);
+				if (_columns){
+					status("\tExtracting terrain and art columns ("s + name + ")"s);
+					queue.add([facet,filepath = mappath / std::filesystem::path("terrain.cols")](){
+						facet->saveTerrainColumns(filepath.string());
+					});
+					queue.add([facet,filepath = mappath / std::filesystem::path("art.cols")](){
+						facet->saveArtColumns(filepath.string());
+					});
+					queue.wait();
 				}
-				output.close();
-				
 			}
-			if (_map5){
-				auto mappath = path / std::filesystem::path("map5");
-				if (!std::filesystem::exists(mappath)){
-					std::filesystem::create_directory(mappath);
-				}
-				auto radarpath = mappath / std::filesystem::path("radar.bmp");
-				auto terrainpath = mappath/std::filesystem::path("terrain.csv");
-				auto artpath = mappath/std::filesystem::path("art.csv");
-				UO::MapTerArt mapdata(5,0,0) ;
-				std::cout <<"Loading map 5 data"<<std::endl;
-				mapdata.load(uodir.string());
-				if (!mapdata.uop()){
-					mapdata.applyTerrainDiff(uodir.string(), uodir.string());
-				}
-				mapdata.applyArtDiff(uodir.string(), uodir.string(), uodir.string());
-				std::cout <<"\tExtracting radar map" << std::endl;
-				auto bitmap = mapdata.radar(palette);
-				bitmap.save(radarpath.string());
-				std::cout <<"\tExtracting terrain info" << std::endl;
-				std::ofstream output(terrainpath.string()) ;
-				UO::tile_info infostub ;
-				infostub.type = UO::TileType::terrain ;
-				output <<"y,x,z,tileid,"<<infostub.csvTitle()<<std::endl;
-				for (auto y=0; y < mapdata.mapHeight();y++){
-					for (auto x=0;x<mapdata.mapWidth();x++){
-						auto tile = mapdata.terrain(x, y);
-						output << y<<","<<x<<","<<tile.z<<","<<strutil::numtostr(tile.tileid,16,true,4)<<","<<tile.info.csvRow()<<std::endl;
-					}
-				}
-				output.close();
-				// now do the art work
-				std::cout <<"\tExtracting art info" << std::endl;
-				output.open(artpath.string());
-				infostub.type = UO::TileType::art;
-				output <<"y,x,z,tileid,static hue,"<<infostub.csvTitle()<<std::endl;
-				for (auto y=0; y < mapdata.mapHeight();y++){
-					for (auto x=0;x<mapdata.mapWidth();x++){
-						auto tiles = mapdata.art(x, y);
-						for (const auto &entry: tiles){
-							output<<y<<","<<x<<","<<entry.z<<","<<strutil::numtostr(entry.artHue,16,true,4)<<","<<entry.info.csvRow()<<std::endl;
-						}
-					}
-				}
-				output.close();
-				
+			if (_columns && !facets.empty()){
+				status("\tExtracting tile information columns"s);
+				tiledata->saveTerrainColumns((path / std::filesystem::path("tiledata_terrain.cols")).string());
+				tiledata->saveArtColumns((path / std::filesystem::path("tiledata_art.cols")).string());
 			}
 		}
 		if (_light){
@@ -562,12 +511,15 @@ int main(int argc, const char * argv[]) {
 			UO::LightData lights(uodir.string());
 			std::cout <<"Extracting light information << std::endl;";
 			for (auto i = 0 ; i < lights.maxID();i++){
-				auto bitmap = lights.bitmap(i);
-				if (!bitmap.empty()){
-					auto filepath = path / std::filesystem::path(strutil::numtostr(i,16,true,4)+".bmp"s);
-					bitmap.save(filepath.string());
-				}
+				queue.add([&lights,path,i](){
+					auto bitmap = lights.bitmap(i);
+					if (!bitmap.empty()){
+						auto filepath = path / std::filesystem::path(outputName(strutil::numtostr(i,16,true,4)+".bmp"s));
+						bitmap.save(filepath.string());
+					}
+				});
 			}
+			queue.wait();
 			
 		}
 	}